@@ -0,0 +1,664 @@
+/*
+   This file is part of DFBTerm.
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along
+   with this program; if not, write to the Free Software Foundation, Inc.,
+   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA
+*/
+
+#include <config.h>
+#include <bench.h>
+#include <bench-draw.h>
+#include <libzvt/vtx.h>
+#ifdef HAVE_LIBTSM
+#include <libtsm.h>
+#endif
+#include <malloc.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <term-record.h>
+#include <unistd.h>
+
+/**********************************************************************************************************************/
+
+/*
+ * Every allocation of the benchmark is counted, including the ones made inside libtsm. The emulator runs in a child
+ * process of its own, so that the counters and the peak RSS only cover one backend.
+ */
+
+#ifdef __GLIBC__
+extern void *__libc_malloc ( size_t size );
+extern void *__libc_calloc ( size_t nmemb, size_t size );
+extern void *__libc_realloc( void *ptr, size_t size );
+
+static unsigned long long alloc_calls;
+static unsigned long long alloc_bytes;
+
+void *malloc( size_t size )
+{
+     alloc_calls++;
+     alloc_bytes += size;
+
+     return __libc_malloc( size );
+}
+
+void *calloc( size_t nmemb, size_t size )
+{
+     alloc_calls++;
+     alloc_bytes += nmemb * size;
+
+     return __libc_calloc( nmemb, size );
+}
+
+void *realloc( void *ptr, size_t size )
+{
+     alloc_calls++;
+     alloc_bytes += size;
+
+     return __libc_realloc( ptr, size );
+}
+#define HAVE_ALLOC_COUNTERS 1
+#else
+#define HAVE_ALLOC_COUNTERS 0
+#endif
+
+static long heap_in_use()
+{
+#if defined(__GLIBC__) && __GLIBC_PREREQ(2,33)
+     return mallinfo2().uordblks;
+#else
+     return 0;
+#endif
+}
+
+static long peak_rss()
+{
+     struct rusage usage;
+
+     getrusage( RUSAGE_SELF, &usage );
+
+     return usage.ru_maxrss;
+}
+
+/**********************************************************************************************************************/
+
+/* Corpus split into frames, i.e. the chunks parsed before each redraw */
+typedef struct {
+     BenchCorpus  corpus;
+     size_t      *frames; /* end offset of each frame */
+     int          num_frames;
+} Stream;
+
+typedef struct {
+     long long           time;
+     unsigned long long  draw_calls;
+     unsigned long long  draw_cells;
+     unsigned long long  alloc_calls;
+     unsigned long long  alloc_bytes;
+     long                heap;     /* bytes still allocated by the emulator after the replay */
+     long                base_rss; /* kB, before the emulator is created */
+     long                peak_rss; /* kB */
+} BackendResult;
+
+typedef struct {
+     const char *name;
+     void      (*run)( const Stream *stream, int cols, int rows, BackendResult *result );
+} Backend;
+
+static void stream_add_frame( Stream *stream, size_t end )
+{
+     if (stream->num_frames && stream->frames[stream->num_frames-1] == end)
+          return;
+
+     if (!(stream->num_frames & 255))
+          stream->frames = realloc( stream->frames, (stream->num_frames + 256) * sizeof(size_t) );
+
+     stream->frames[stream->num_frames++] = end;
+}
+
+/* Without recording, every chunk is one frame, as if it was returned by a single read() in term_update() */
+static void stream_split( Stream *stream )
+{
+     size_t offset;
+
+     for (offset = BENCH_CHUNK_SIZE; offset < stream->corpus.size; offset += BENCH_CHUNK_SIZE)
+          stream_add_frame( stream, offset );
+
+     stream_add_frame( stream, stream->corpus.size );
+}
+
+/* Recordings made with --record, each update is a frame */
+static int stream_load_record( Stream *stream, const char *filename )
+{
+     int         ret;
+     const char *buffer;
+     size_t      count;
+     size_t      alloc  = 0;
+     TermRecord *record = term_record_open( filename, 1 );
+
+     if (!record)
+          return -1;
+
+     while ((ret = term_record_read( record, &buffer, &count )) > 0) {
+          if (!count) {
+               stream_add_frame( stream, stream->corpus.size );
+               continue;
+          }
+
+          if (stream->corpus.size + count > alloc) {
+               alloc = alloc * 2 + count;
+               stream->corpus.data = realloc( stream->corpus.data, alloc );
+          }
+
+          memcpy( stream->corpus.data + stream->corpus.size, buffer, count );
+          stream->corpus.size += count;
+     }
+
+     term_record_close( record );
+
+     if (ret)
+          return -1;
+
+     stream_add_frame( stream, stream->corpus.size );
+
+     return 0;
+}
+
+static int stream_load( Stream *stream, const char *filename )
+{
+     const char *name;
+
+     memset( stream, 0, sizeof(Stream) );
+
+     if (bench_corpus_load( &stream->corpus, filename ))
+          return -1;
+
+     if (stream->corpus.size < 8 || memcmp( stream->corpus.data, TERM_RECORD_MAGIC, 8 )) {
+          stream_split( stream );
+          return 0;
+     }
+
+     free( stream->corpus.data );
+
+     stream->corpus.data = NULL;
+     stream->corpus.size = 0;
+
+     name = strrchr( filename, '/' );
+
+     if (stream_load_record( stream, filename )) {
+          fprintf( stderr, "%s: broken recording\n", filename );
+          return -1;
+     }
+
+     free( stream->corpus.name );
+     stream->corpus.name = strdup( name ? name + 1 : filename );
+
+     return 0;
+}
+
+static void stream_free( Stream *stream )
+{
+     bench_corpus_free( &stream->corpus );
+
+     free( stream->frames );
+}
+
+/**********************************************************************************************************************/
+
+static void zvt_run( const Stream *stream, int cols, int rows, BackendResult *result )
+{
+     int            i;
+     size_t         offset = 0;
+     long long      t;
+     struct _vtx   *vtx;
+     TermSnapshots *snapshots;
+     TermSnapshot  *snapshot;
+     BenchDraw      draw;
+
+     memset( &draw, 0, sizeof(draw) );
+
+     vtx = vtx_new( cols, rows, NULL );
+
+     vt_scrollback_set( &vtx->vt, BENCH_DEFAULT_LINES );
+
+     snapshots = term_snapshots_create();
+
+     t = bench_now();
+
+     /* Same sequence as term_input(), term_redraw() and term_render(), every frame is drawn */
+     for (i = 0; i < stream->num_frames; i++) {
+          vt_parse_vt( &vtx->vt, stream->corpus.data + offset, stream->frames[i] - offset );
+
+          snapshot = term_snapshots_begin( snapshots, cols, rows );
+
+          term_snapshot_compose( snapshots, snapshot, vtx );
+
+          term_snapshots_publish( snapshots );
+
+          vt_scrollback_pack( &vtx->vt );
+
+          bench_draw_snapshot( &draw, term_snapshots_acquire( snapshots ) );
+
+          offset = stream->frames[i];
+     }
+
+     result->time = bench_now() - t;
+     result->heap = heap_in_use();
+
+     result->draw_calls = draw.draw_calls + draw.scroll_calls;
+     result->draw_cells = draw.draw_cells;
+
+     term_snapshots_destroy( snapshots );
+
+     bench_draw_free( &draw );
+
+     vtx_destroy( vtx );
+}
+
+#ifdef HAVE_LIBTSM
+/* Same as the TermCell of libtsm snapshots */
+typedef struct {
+     uint32_t  ch;
+     uint8_t   fr, fg, fb;
+     uint8_t   br, bg, bb;
+     uint8_t   inverse;
+     uint8_t   width;
+} TsmCell;
+
+typedef struct {
+     int                 cols, rows;
+     TsmCell            *cells;
+     TsmCell            *shown;
+     unsigned long long *ids;
+     unsigned long long *shown_ids;
+     BackendResult      *result;
+} TsmCounter;
+
+static void tsm_write( struct tsm_vte *vte, const char *buffer, size_t count, void *user_data )
+{
+}
+
+/* Same as compose_cell() in term-snapshot.c */
+static int tsm_draw( struct tsm_screen *screen, uint64_t id, const uint32_t *ch, size_t size, uint32_t len,
+                     uint32_t posx, uint32_t posy, const struct tsm_screen_attr *attr, tsm_age_t age, void *user_data )
+{
+     TsmCounter *counter = user_data;
+     TsmCell    *cell;
+
+     if (posx >= counter->cols || posy >= counter->rows)
+          return 0;
+
+     cell = &counter->cells[posy * counter->cols + posx];
+
+     cell->ch      = size ? *ch : 0;
+     cell->fr      = attr->fr;
+     cell->fg      = attr->fg;
+     cell->fb      = attr->fb;
+     cell->br      = attr->br;
+     cell->bg      = attr->bg;
+     cell->bb      = attr->bb;
+     cell->inverse = attr->inverse;
+     cell->width   = len;
+
+     return 0;
+}
+
+/* Same as term_snapshot_compose() and term_draw_snapshot() with libtsm, the rows are identified by their hash */
+static void tsm_count( TsmCounter *counter, struct tsm_screen *screen )
+{
+     int                 row, col, scroll;
+     int                 cols = counter->cols;
+     int                 rows = counter->rows;
+     const uint32_t     *words;
+     unsigned long long  hash;
+
+     memset( counter->cells, 0, cols * rows * sizeof(TsmCell) );
+
+     tsm_screen_draw( screen, tsm_draw, counter );
+
+     for (row = 0; row < rows; row++) {
+          words = (const uint32_t*) (counter->cells + row * cols);
+          hash  = 0xcbf29ce484222325ULL;
+
+          for (col = 0; col < cols * sizeof(TsmCell) / 4; col++) {
+               hash ^= words[col];
+               hash *= 0x100000001b3ULL;
+          }
+
+          counter->ids[row] = hash ? hash : 1;
+     }
+
+     if ((scroll = bench_find_scroll( counter->shown_ids, counter->ids, rows )) > 0) {
+          counter->result->draw_calls++;
+
+          memmove( counter->shown, counter->shown + scroll * cols, (rows - scroll) * cols * sizeof(TsmCell) );
+          memmove( counter->shown_ids, counter->shown_ids + scroll, (rows - scroll) * sizeof(unsigned long long) );
+     }
+     else if (scroll < 0) {
+          counter->result->draw_calls++;
+
+          memmove( counter->shown - scroll * cols, counter->shown, (rows + scroll) * cols * sizeof(TsmCell) );
+          memmove( counter->shown_ids - scroll, counter->shown_ids, (rows + scroll) * sizeof(unsigned long long) );
+     }
+
+     for (row = 0; row < rows; row++) {
+          TsmCell *cells = counter->cells + row * cols;
+          TsmCell *shown = counter->shown + row * cols;
+
+          if (counter->ids[row] == counter->shown_ids[row])
+               continue;
+
+          /* Every changed cell is drawn on its own */
+          for (col = 0; col < cols; col++) {
+               if (!memcmp( &cells[col], &shown[col], sizeof(TsmCell) ))
+                    continue;
+
+               if (cells[col].width) {
+                    counter->result->draw_calls++;
+                    counter->result->draw_cells++;
+               }
+
+               shown[col] = cells[col];
+          }
+
+          counter->shown_ids[row] = counter->ids[row];
+     }
+}
+
+static void tsm_run( const Stream *stream, int cols, int rows, BackendResult *result )
+{
+     int                i;
+     size_t             offset = 0;
+     long long          t;
+     struct tsm_screen *screen;
+     struct tsm_vte    *vte;
+     TsmCounter         counter;
+
+     if (tsm_screen_new( &screen, NULL, NULL )) {
+          fprintf( stderr, "tsm_screen_new() failed\n" );
+          return;
+     }
+
+     if (tsm_vte_new( &vte, screen, tsm_write, NULL, NULL, NULL )) {
+          fprintf( stderr, "tsm_vte_new() failed\n" );
+          tsm_screen_unref( screen );
+          return;
+     }
+
+     tsm_screen_set_max_sb( screen, BENCH_DEFAULT_LINES );
+     tsm_screen_resize( screen, cols, rows );
+
+     memset( &counter, 0, sizeof(counter) );
+
+     counter.cols      = cols;
+     counter.rows      = rows;
+     counter.cells     = malloc( cols * rows * sizeof(TsmCell) );
+     counter.shown     = malloc( cols * rows * sizeof(TsmCell) );
+     counter.ids       = malloc( rows * sizeof(unsigned long long) );
+     counter.shown_ids = calloc( rows, sizeof(unsigned long long) );
+     counter.result    = result;
+
+     /* Nothing is shown yet */
+     memset( counter.shown, 0xff, cols * rows * sizeof(TsmCell) );
+
+     t = bench_now();
+
+     /* Same sequence as shl_pty_input() and term_render(), every frame is drawn */
+     for (i = 0; i < stream->num_frames; i++) {
+          tsm_vte_input( vte, stream->corpus.data + offset, stream->frames[i] - offset );
+
+          tsm_count( &counter, screen );
+
+          offset = stream->frames[i];
+     }
+
+     result->time = bench_now() - t;
+     result->heap = heap_in_use();
+
+     tsm_vte_unref( vte );
+     tsm_screen_unref( screen );
+
+     free( counter.cells );
+     free( counter.shown );
+     free( counter.ids );
+     free( counter.shown_ids );
+}
+#endif
+
+static const Backend backends[] = {
+     { "libzvt", zvt_run },
+#ifdef HAVE_LIBTSM
+     { "libtsm", tsm_run },
+#endif
+};
+
+#define NUM_BACKENDS (sizeof(backends) / sizeof(backends[0]))
+
+/**********************************************************************************************************************/
+
+static int backend_run( const Backend *backend, const Stream *stream, int cols, int rows, BackendResult *result )
+{
+     int   fds[2];
+     int   status;
+     pid_t pid;
+
+     memset( result, 0, sizeof(BackendResult) );
+
+     if (pipe( fds )) {
+          perror( "pipe" );
+          return -1;
+     }
+
+     pid = fork();
+     if (pid < 0) {
+          perror( "fork" );
+          close( fds[0] );
+          close( fds[1] );
+          return -1;
+     }
+
+     if (pid == 0) {
+          long heap;
+
+          close( fds[0] );
+
+          result->base_rss = peak_rss();
+
+          heap = heap_in_use();
+
+#if HAVE_ALLOC_COUNTERS
+          alloc_calls = 0;
+          alloc_bytes = 0;
+#endif
+
+          backend->run( stream, cols, rows, result );
+
+#if HAVE_ALLOC_COUNTERS
+          result->alloc_calls = alloc_calls;
+          result->alloc_bytes = alloc_bytes;
+#endif
+
+          result->heap    -= heap;
+          result->peak_rss = peak_rss();
+
+          _exit( write( fds[1], result, sizeof(BackendResult) ) != sizeof(BackendResult) );
+     }
+
+     close( fds[1] );
+
+     status = read( fds[0], result, sizeof(BackendResult) ) != sizeof(BackendResult);
+
+     close( fds[0] );
+
+     waitpid( pid, NULL, 0 );
+
+     if (status)
+          fprintf( stderr, "%s: no result\n", backend->name );
+
+     return status ? -1 : 0;
+}
+
+static void report_row( const char *label, const double *values, const int *valid, int num, const char *format )
+{
+     int  i;
+     char value[32];
+
+     printf( "  %-20s", label );
+
+     for (i = 0; i < num; i++) {
+          if (valid[i])
+               snprintf( value, sizeof(value), format, values[i] );
+          else
+               snprintf( value, sizeof(value), "-" );
+
+          printf( " %12s", value );
+     }
+
+     printf( "\n" );
+}
+
+static void run_stream( const Stream *stream, int cols, int rows, const char *only )
+{
+     unsigned int  i;
+     int           num = 0;
+     int           valid[NUM_BACKENDS];
+     double        values[NUM_BACKENDS];
+     BackendResult results[NUM_BACKENDS];
+
+     printf( "%s: %zu bytes, %d frames, %dx%d\n", stream->corpus.name, stream->corpus.size, stream->num_frames,
+             cols, rows );
+
+     printf( "  %-20s", "" );
+
+     for (i = 0; i < NUM_BACKENDS; i++) {
+          if (only && strcmp( only, backends[i].name ))
+               continue;
+
+          valid[num] = !backend_run( &backends[i], stream, cols, rows, &results[num] ) && results[num].time > 0;
+
+          printf( " %12s", backends[i].name );
+
+          num++;
+     }
+
+     printf( "\n" );
+
+#define REPORT(label,format,expr)                \
+     do {                                        \
+          for (i = 0; i < num; i++) {            \
+               BackendResult *r = &results[i];   \
+               values[i] = (expr);               \
+          }                                      \
+          report_row( label, values, valid, num, format ); \
+     } while (0)
+
+     REPORT( "MB/s",          "%.1f", stream->corpus.size * 1000.0 / r->time );
+     REPORT( "us/frame",      "%.1f", r->time / 1000.0 / stream->num_frames );
+     REPORT( "draws/frame",   "%.1f", (double) r->draw_calls / stream->num_frames );
+     REPORT( "cells/frame",   "%.1f", (double) r->draw_cells / stream->num_frames );
+
+     if (HAVE_ALLOC_COUNTERS) {
+          REPORT( "allocations",   "%.0f", (double) r->alloc_calls );
+          REPORT( "kB allocated",  "%.0f", r->alloc_bytes / 1024.0 );
+     }
+
+     REPORT( "kB heap in use", "%.0f", r->heap / 1024.0 );
+     REPORT( "kB peak RSS",    "%.0f", (double) r->peak_rss );
+     REPORT( "kB RSS growth",  "%.0f", (double) (r->peak_rss - r->base_rss) );
+
+#undef REPORT
+
+     printf( "\n" );
+}
+
+static void bench_usage()
+{
+     unsigned int i;
+
+     printf( "Cross-backend benchmark\n\n" );
+     printf( "Usage: bench-backends [options] [files...]\n\n" );
+     printf( "Replays the same stream through every emulator backend built in:" );
+     for (i = 0; i < NUM_BACKENDS; i++)
+          printf( " %s", backends[i].name );
+     printf( ".\n" );
+     printf( "Files are either recordings made with 'dfbterm --record', where each update is a frame,\n" );
+     printf( "or raw output split into %d bytes frames. Without files, the built-in corpora are generated.\n\n",
+             BENCH_CHUNK_SIZE );
+     printf( "Options:\n\n" );
+     printf( "  --size=<cols>x<rows>  Set terminal size (default = %dx%d).\n", BENCH_DEFAULT_COLS, BENCH_DEFAULT_ROWS );
+     printf( "  --corpus-size=<kB>    Set size of the generated corpora (default = %d).\n",
+             BENCH_DEFAULT_CORPUS_SIZE / 1024 );
+     printf( "  --backend=<name>      Only run the given backend.\n" );
+     printf( "  --help                Print usage information.\n" );
+}
+
+int main( int argc, char *argv[] )
+{
+     int         i;
+     int         cols  = BENCH_DEFAULT_COLS;
+     int         rows  = BENCH_DEFAULT_ROWS;
+     size_t      size  = BENCH_DEFAULT_CORPUS_SIZE;
+     int         files = 0;
+     const char *only  = NULL;
+     Stream      stream;
+
+     for (i = 1; i < argc; i++) {
+          if (!strcmp( argv[i], "--help" )) {
+               bench_usage();
+               return 0;
+          }
+          else if (strstr( argv[i], "--size=" ) == argv[i]) {
+               if (bench_parse_size( 1 + strchr( argv[i], '=' ), &cols, &rows ))
+                    return 1;
+          }
+          else if (strstr( argv[i], "--corpus-size=" ) == argv[i]) {
+               size = atoi( 1 + strchr( argv[i], '=' ) ) * 1024;
+          }
+          else if (strstr( argv[i], "--backend=" ) == argv[i]) {
+               only = 1 + strchr( argv[i], '=' );
+          }
+          else if (argv[i][0] == '-') {
+               bench_usage();
+               return 1;
+          }
+          else
+               files++;
+     }
+
+     /* The report goes through a pipe when run by meson, do not let the children inherit unflushed output */
+     setvbuf( stdout, NULL, _IOLBF, 0 );
+
+     for (i = 0; files ? i < argc : bench_corpus_names[i] != NULL; i++) {
+          if (files) {
+               if (i == 0 || argv[i][0] == '-')
+                    continue;
+
+               if (stream_load( &stream, argv[i] ))
+                    return 1;
+          }
+          else {
+               memset( &stream, 0, sizeof(Stream) );
+               bench_corpus_generate( &stream.corpus, bench_corpus_names[i], size );
+               stream_split( &stream );
+          }
+
+          run_stream( &stream, cols, rows, only );
+
+          stream_free( &stream );
+     }
+
+     return 0;
+}
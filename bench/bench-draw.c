@@ -0,0 +1,136 @@
+/*
+   This file is part of DFBTerm.
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along
+   with this program; if not, write to the Free Software Foundation, Inc.,
+   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA
+*/
+
+#include <bench-draw.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**********************************************************************************************************************/
+
+int bench_find_scroll( const unsigned long long *shown_ids, const unsigned long long *ids, int rows )
+{
+     int i, j, r, d, tried, matches;
+     int best         = 0;
+     int best_matches = 0;
+
+     for (i = 0; i < rows; i++)
+          if (ids[i] == shown_ids[i])
+               best_matches++;
+
+     for (r = 0, tried = 0; r < rows && tried < 4; r++) {
+          if (ids[r] == shown_ids[r])
+               continue;
+
+          tried++;
+
+          for (j = 0; j < rows; j++) {
+               if (j == r || shown_ids[j] != ids[r])
+                    continue;
+
+               d = j - r;
+
+               for (i = d < 0 ? -d : 0, matches = 0; i < rows && i + d < rows; i++)
+                    if (ids[i] == shown_ids[i+d])
+                         matches++;
+
+               if (matches > best_matches) {
+                    best         = d;
+                    best_matches = matches;
+               }
+          }
+     }
+
+     return best_matches > rows / 2 ? best : 0;
+}
+
+/* Same as draw_row() in term-draw.c */
+static void draw_row( BenchDraw *draw, const TermCell *cells, TermCell *shown, int cols )
+{
+     int i, start;
+
+     for (i = 0; i < cols; ) {
+          if (cells[i] == shown[i]) {
+               i++;
+               continue;
+          }
+
+          start = i++;
+
+          while (i < cols && cells[i] != shown[i] && (cells[i] & VTATTR_MASK) == (cells[start] & VTATTR_MASK))
+               i++;
+
+          draw->draw_calls++;
+          draw->draw_cells += i - start;
+
+          memcpy( shown + start, cells + start, (i - start) * sizeof(TermCell) );
+     }
+}
+
+void bench_draw_snapshot( BenchDraw *draw, const TermSnapshot *snapshot )
+{
+     int row, scroll;
+     int cols = snapshot->cols;
+     int rows = snapshot->rows;
+
+     if (cols != draw->cols || rows != draw->rows) {
+          draw->shown     = realloc( draw->shown, cols * rows * sizeof(TermCell) );
+          draw->shown_ids = realloc( draw->shown_ids, rows * sizeof(unsigned long long) );
+          draw->cols      = cols;
+          draw->rows      = rows;
+
+          memset( draw->shown, 0xff, cols * rows * sizeof(TermCell) );
+          memset( draw->shown_ids, 0, rows * sizeof(unsigned long long) );
+     }
+     else if ((scroll = bench_find_scroll( draw->shown_ids, snapshot->ids, rows )) > 0) {
+          draw->scroll_calls++;
+          draw->scroll_rows += rows - scroll;
+
+          memmove( draw->shown, draw->shown + scroll * cols, (rows - scroll) * cols * sizeof(TermCell) );
+          memmove( draw->shown_ids, draw->shown_ids + scroll, (rows - scroll) * sizeof(unsigned long long) );
+     }
+     else if (scroll < 0) {
+          draw->scroll_calls++;
+          draw->scroll_rows += rows + scroll;
+
+          memmove( draw->shown - scroll * cols, draw->shown, (rows + scroll) * cols * sizeof(TermCell) );
+          memmove( draw->shown_ids - scroll, draw->shown_ids, (rows + scroll) * sizeof(unsigned long long) );
+     }
+
+     for (row = 0; row < rows; row++) {
+          if (snapshot->ids[row] == draw->shown_ids[row])
+               continue;
+
+          draw->diff_rows++;
+
+          draw_row( draw, snapshot->cells + row * cols, draw->shown + row * cols, cols );
+
+          draw->shown_ids[row] = snapshot->ids[row];
+     }
+}
+
+void bench_draw_invalidate( BenchDraw *draw )
+{
+     draw->cols = 0;
+     draw->rows = 0;
+}
+
+void bench_draw_free( BenchDraw *draw )
+{
+     free( draw->shown );
+     free( draw->shown_ids );
+}
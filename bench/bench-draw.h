@@ -0,0 +1,47 @@
+/*
+   This file is part of DFBTerm.
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along
+   with this program; if not, write to the Free Software Foundation, Inc.,
+   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA
+*/
+
+#ifndef __BENCH_DRAW_H__
+#define __BENCH_DRAW_H__
+
+#include <term-snapshot.h>
+
+/* Counts what term_draw_snapshot() draws for the snapshots of libzvt, instead of drawing */
+typedef struct {
+     int                 cols, rows;
+     TermCell           *shown;
+     unsigned long long *shown_ids;
+
+     unsigned long long  draw_calls;   /* runs of cells with the same attributes */
+     unsigned long long  draw_cells;
+     unsigned long long  scroll_calls;
+     unsigned long long  scroll_rows;
+     unsigned long long  diff_rows;    /* rows with a new id, compared cell by cell */
+} BenchDraw;
+
+void bench_draw_snapshot  ( BenchDraw *draw, const TermSnapshot *snapshot );
+
+/* Forget what is shown, the next snapshot is drawn entirely */
+void bench_draw_invalidate( BenchDraw *draw );
+
+void bench_draw_free      ( BenchDraw *draw );
+
+/* Same as find_scroll() in term-draw.c, for ids of rows of any kind */
+int  bench_find_scroll    ( const unsigned long long *shown_ids, const unsigned long long *ids, int rows );
+
+#endif
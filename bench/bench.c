@@ -0,0 +1,322 @@
+/*
+   This file is part of DFBTerm.
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along
+   with this program; if not, write to the Free Software Foundation, Inc.,
+   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA
+*/
+
+#include <bench.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/**********************************************************************************************************************/
+
+const char *const bench_corpus_names[] = {
+     "cat-log",
+     "ls-color",
+     "vim-redraw",
+     "htop-redraw",
+     "utf8-text",
+     NULL
+};
+
+typedef struct {
+     char         *data;
+     size_t        size;
+     size_t        alloc;
+     unsigned int  seed;
+} Buffer;
+
+static void buffer_printf( Buffer *buffer, const char *fmt, ... )
+{
+     int     len;
+     va_list args;
+
+     while (1) {
+          va_start( args, fmt );
+          len = vsnprintf( buffer->data + buffer->size, buffer->alloc - buffer->size, fmt, args );
+          va_end( args );
+
+          if (buffer->size + len < buffer->alloc)
+               break;
+
+          buffer->alloc = buffer->alloc * 2 + len + 1;
+          buffer->data  = realloc( buffer->data, buffer->alloc );
+     }
+
+     buffer->size += len;
+}
+
+/* Deterministic pseudo random numbers, so that every run parses the same bytes */
+static unsigned int buffer_random( Buffer *buffer, unsigned int range )
+{
+     buffer->seed = buffer->seed * 1103515245 + 12345;
+
+     return (buffer->seed >> 16) % range;
+}
+
+/**********************************************************************************************************************/
+
+static const char *const words[] = {
+     "request", "completed", "connection", "timeout", "worker", "session", "buffer", "flush", "render", "surface",
+     "window", "thread", "client", "server", "update", "cache", "config", "device", "socket", "handler"
+};
+
+static void generate_cat_log( Buffer *buffer, size_t size )
+{
+     static const char *const levels[] = { "DEBUG", "INFO ", "INFO ", "INFO ", "WARN ", "ERROR" };
+
+     unsigned int n = 0;
+
+     while (buffer->size < size) {
+          int i, count = 3 + buffer_random( buffer, 9 );
+
+          buffer_printf( buffer, "2026-10-17 %02u:%02u:%02u.%03u %s [worker-%u] ",
+                         (n / 3600000) % 24, (n / 60000) % 60, (n / 1000) % 60, n % 1000,
+                         levels[buffer_random( buffer, 6 )], buffer_random( buffer, 16 ) );
+
+          for (i = 0; i < count; i++)
+               buffer_printf( buffer, "%s ", words[buffer_random( buffer, 20 )] );
+
+          buffer_printf( buffer, "id=%u in %u ms\r\n", buffer_random( buffer, 100000 ), buffer_random( buffer, 500 ) );
+
+          n += buffer_random( buffer, 250 );
+     }
+}
+
+static void generate_ls_color( Buffer *buffer, size_t size )
+{
+     static const char *const colors[] = { "01;34", "01;32", "01;36", "00", "00", "00", "01;31", "01;35" };
+     static const char *const modes[]  = { "drwxr-xr-x", "-rwxr-xr-x", "lrwxrwxrwx", "-rw-r--r--",
+                                           "-rw-r--r--", "-rw-r--r--", "-rw-r--r--", "-rw-r--r--" };
+
+     unsigned int dir = 0;
+
+     while (buffer->size < size) {
+          int i, count = 5 + buffer_random( buffer, 30 );
+
+          buffer_printf( buffer, "./src/%s/%s%u:\r\ntotal %u\r\n",
+                         words[dir % 20], words[(dir / 20) % 20], dir, buffer_random( buffer, 1000 ) );
+
+          for (i = 0; i < count; i++) {
+               int type = buffer_random( buffer, 8 );
+
+               buffer_printf( buffer, "%s %2u user user %8u Oct %2u %02u:%02u \033[0m\033[%sm%s_%s%s\033[0m\r\n",
+                              modes[type], 1 + buffer_random( buffer, 4 ), buffer_random( buffer, 1000000 ),
+                              1 + buffer_random( buffer, 31 ), buffer_random( buffer, 24 ), buffer_random( buffer, 60 ),
+                              colors[type], words[buffer_random( buffer, 20 )], words[buffer_random( buffer, 20 )],
+                              type == 0 ? "" : type == 1 ? ".sh" : type == 6 ? ".tar.gz" : ".c" );
+          }
+
+          buffer_printf( buffer, "\r\n" );
+
+          dir++;
+     }
+}
+
+static void generate_vim_redraw( Buffer *buffer, size_t size, int cols, int rows )
+{
+     static const char *const syntax[] = { "\033[33m", "\033[32m", "\033[35m", "\033[36m", "\033[1m\033[34m", "\033[0m" };
+
+     unsigned int frame = 0;
+
+     /* Switch to the alternate screen, like vim does */
+     buffer_printf( buffer, "\033[?1049h\033[1;%dr\033[?25l", rows );
+
+     while (buffer->size < size) {
+          int row;
+
+          buffer_printf( buffer, "\033[H\033[2J" );
+
+          for (row = 1; row < rows - 1; row++) {
+               int col = 0;
+
+               buffer_printf( buffer, "\033[%d;1H", row );
+
+               if (row > rows - 6) {
+                    buffer_printf( buffer, "\033[1m\033[34m~\033[0m" );
+                    continue;
+               }
+
+               buffer_printf( buffer, "\033[33m%4u \033[0m", frame + row );
+
+               col += 5 + buffer_random( buffer, 8 );
+               buffer_printf( buffer, "%*s", col - 5, "" );
+
+               while (col < cols - 12) {
+                    const char *word = words[buffer_random( buffer, 20 )];
+
+                    buffer_printf( buffer, "%s%s\033[0m%c", syntax[buffer_random( buffer, 6 )], word,
+                                   buffer_random( buffer, 4 ) ? ' ' : '(' );
+
+                    col += strlen( word ) + 1;
+
+                    if (!buffer_random( buffer, 5 ))
+                         break;
+               }
+
+               buffer_printf( buffer, "\033[K" );
+          }
+
+          buffer_printf( buffer, "\033[%d;1H\033[7m src/%s.c [+] %*s %u,%u  %u%% \033[27m",
+                         rows - 1, words[frame % 20], cols - 40, "", frame + 1, 1 + frame % 40, frame % 100 );
+
+          buffer_printf( buffer, "\033[%d;1H\033[K-- INSERT --\033[%u;%uH\033[?25h",
+                         rows, 1 + buffer_random( buffer, rows - 2 ), 6 + buffer_random( buffer, 40 ) );
+
+          frame++;
+     }
+
+     buffer_printf( buffer, "\033[?1049l" );
+}
+
+static void generate_htop_redraw( Buffer *buffer, size_t size, int cols, int rows )
+{
+     static const char *const states[] = { "S", "S", "S", "R", "D" };
+
+     unsigned int frame = 0;
+
+     buffer_printf( buffer, "\033[?1049h\033[H\033[2J" );
+
+     while (buffer->size < size) {
+          int cpu, row;
+
+          for (cpu = 0; cpu < 4; cpu++) {
+               int used = buffer_random( buffer, 30 );
+
+               buffer_printf( buffer, "\033[%d;3H\033[36m%d\033[39m\033[1m[\033[32m%.*s\033[31m%.*s\033[39m%*s%4.1f%%]\033[0m",
+                              cpu + 1, cpu, used, "||||||||||||||||||||||||||||||", used / 3, "||||||||||",
+                              30 - used - used / 3, "", used * 3.3 );
+          }
+
+          buffer_printf( buffer, "\033[6;1H\033[30;42m  PID USER      PRI  NI  VIRT   RES   SHR S CPU%% MEM%%   TIME+  Command%*s\033[0m",
+                         cols - 71, "" );
+
+          for (row = 7; row < rows; row++) {
+               buffer_printf( buffer, "\033[%d;1H%s%5u user       20   0 %5uM %5uM %5uM %s %4.1f %4.1f %2u:%02u.%02u %s/%s\033[K\033[0m",
+                              row, row == 7 ? "\033[30;46m" : "", 100 + buffer_random( buffer, 30000 ),
+                              buffer_random( buffer, 4000 ), buffer_random( buffer, 900 ), buffer_random( buffer, 200 ),
+                              states[buffer_random( buffer, 5 )], buffer_random( buffer, 1000 ) / 10.0,
+                              buffer_random( buffer, 200 ) / 10.0, buffer_random( buffer, 60 ), buffer_random( buffer, 60 ),
+                              buffer_random( buffer, 100 ), words[buffer_random( buffer, 20 )], words[buffer_random( buffer, 20 )] );
+          }
+
+          frame++;
+     }
+
+     buffer_printf( buffer, "\033[?1049l" );
+}
+
+static void generate_utf8_text( Buffer *buffer, size_t size )
+{
+     static const char *const phrases[] = {
+          "Grüße aus Köln,", "déjà vu à la française", "Привет, как дела?", "Καλημέρα κόσμε",
+          "こんにちは世界", "你好，世界", "안녕하세요", "شكرا جزيلا", "שלום עולם",
+          "→ ⇒ ∀x ∈ ℝ: x² ≥ 0", "│ ├── └── ┌─┐", "naïve café résumé"
+     };
+
+     /* Select UTF-8, the parser starts in ISO 8859-1 */
+     buffer_printf( buffer, "\033%%G" );
+
+     while (buffer->size < size) {
+          int i, count = 2 + buffer_random( buffer, 5 );
+
+          for (i = 0; i < count; i++)
+               buffer_printf( buffer, "%s ", phrases[buffer_random( buffer, 12 )] );
+
+          buffer_printf( buffer, "\r\n" );
+     }
+}
+
+/**********************************************************************************************************************/
+
+long long bench_now()
+{
+     struct timespec ts;
+
+     clock_gettime( CLOCK_MONOTONIC, &ts );
+
+     return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+int bench_corpus_generate( BenchCorpus *corpus, const char *name, size_t size )
+{
+     Buffer buffer = { NULL, 0, 0, 1 };
+
+     if (!strcmp( name, "cat-log" ))
+          generate_cat_log( &buffer, size );
+     else if (!strcmp( name, "ls-color" ))
+          generate_ls_color( &buffer, size );
+     else if (!strcmp( name, "vim-redraw" ))
+          generate_vim_redraw( &buffer, size, BENCH_DEFAULT_COLS, BENCH_DEFAULT_ROWS );
+     else if (!strcmp( name, "htop-redraw" ))
+          generate_htop_redraw( &buffer, size, BENCH_DEFAULT_COLS, BENCH_DEFAULT_ROWS );
+     else if (!strcmp( name, "utf8-text" ))
+          generate_utf8_text( &buffer, size );
+     else
+          return -1;
+
+     corpus->name = strdup( name );
+     corpus->data = buffer.data;
+     corpus->size = buffer.size;
+
+     return 0;
+}
+
+int bench_corpus_load( BenchCorpus *corpus, const char *filename )
+{
+     FILE       *f;
+     long        size;
+     const char *name;
+
+     f = fopen( filename, "rb" );
+     if (!f) {
+          perror( filename );
+          return -1;
+     }
+
+     fseek( f, 0, SEEK_END );
+     size = ftell( f );
+     fseek( f, 0, SEEK_SET );
+
+     corpus->data = malloc( size ? size : 1 );
+     corpus->size = fread( corpus->data, 1, size, f );
+
+     fclose( f );
+
+     name = strrchr( filename, '/' );
+
+     corpus->name = strdup( name ? name + 1 : filename );
+
+     return 0;
+}
+
+void bench_corpus_free( BenchCorpus *corpus )
+{
+     free( corpus->name );
+     free( corpus->data );
+}
+
+int bench_parse_size( const char *arg, int *cols, int *rows )
+{
+     if (sscanf( arg, "%dx%d", cols, rows ) != 2 || *cols < 1 || *rows < 1) {
+          fprintf( stderr, "Bad size format '%s'\n", arg );
+          return -1;
+     }
+
+     return 0;
+}
@@ -0,0 +1,50 @@
+/*
+   This file is part of DFBTerm.
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along
+   with this program; if not, write to the Free Software Foundation, Inc.,
+   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA
+*/
+
+#ifndef __BENCH_H__
+#define __BENCH_H__
+
+#include <stddef.h>
+
+/* Same defaults as the terminal itself */
+#define BENCH_DEFAULT_COLS     100
+#define BENCH_DEFAULT_ROWS      30
+#define BENCH_DEFAULT_LINES   4000
+
+/* Size of the chunks fed to the parser, matches the read buffer of term_update() */
+#define BENCH_CHUNK_SIZE      4096
+
+#define BENCH_DEFAULT_CORPUS_SIZE (4 * 1024 * 1024)
+
+typedef struct {
+     char   *name;
+     char   *data;
+     size_t  size;
+} BenchCorpus;
+
+extern const char *const bench_corpus_names[];
+
+long long bench_now              ( void );
+
+int       bench_corpus_generate  ( BenchCorpus *corpus, const char *name, size_t size );
+int       bench_corpus_load      ( BenchCorpus *corpus, const char *filename );
+void      bench_corpus_free      ( BenchCorpus *corpus );
+
+int       bench_parse_size       ( const char *arg, int *cols, int *rows );
+
+#endif
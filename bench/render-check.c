@@ -0,0 +1,525 @@
+/*
+   This file is part of DFBTerm.
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along
+   with this program; if not, write to the Free Software Foundation, Inc.,
+   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA
+*/
+
+#include <config.h>
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <term.h>
+
+/**********************************************************************************************************************/
+
+#ifdef USE_LIBTSM
+#define BACKEND "libtsm"
+#else
+#define BACKEND "libzvt"
+#endif
+
+/* Frames are hashed with 64-bit FNV-1a */
+#define FNV_OFFSET 0xcbf29ce484222325ULL
+#define FNV_PRIME  0x100000001b3ULL
+
+typedef struct {
+     char   *data;
+     size_t  size;
+     size_t  alloc;
+} Frame;
+
+typedef struct {
+     Frame  *frames;
+     int     num;
+} Script;
+
+static IDirectFB *dfb;
+
+static void frame_append( Frame *frame, const char *data, size_t size )
+{
+     if (frame->size + size > frame->alloc) {
+          frame->alloc = (frame->size + size) * 2;
+          frame->data  = realloc( frame->data, frame->alloc );
+     }
+
+     memcpy( frame->data + frame->size, data, size );
+
+     frame->size += size;
+}
+
+static Frame *script_add_frame( Script *script )
+{
+     script->frames = realloc( script->frames, (script->num + 1) * sizeof(Frame) );
+
+     memset( &script->frames[script->num], 0, sizeof(Frame) );
+
+     return &script->frames[script->num++];
+}
+
+/*
+ * Text scripts contain one frame per line, written with C-like escapes (\e, \r, \n, \t, \\ and \xHH).
+ * Empty lines and lines starting with '#' are ignored.
+ */
+static int script_load_text( Script *script, FILE *f )
+{
+     char line[4096];
+
+     while (fgets( line, sizeof(line), f )) {
+          char  *p;
+          Frame *frame;
+
+          line[strcspn( line, "\n" )] = 0;
+
+          if (!line[0] || line[0] == '#')
+               continue;
+
+          frame = script_add_frame( script );
+
+          for (p = line; *p; p++) {
+               char c = *p;
+
+               if (c == '\\' && p[1]) {
+                    switch (*++p) {
+                         case 'e':
+                              c = '\033';
+                              break;
+                         case 'r':
+                              c = '\r';
+                              break;
+                         case 'n':
+                              c = '\n';
+                              break;
+                         case 't':
+                              c = '\t';
+                              break;
+                         case 'x': {
+                              char hex[3] = { 0, 0, 0 };
+
+                              if (isxdigit( p[1] )) {
+                                   hex[0] = *++p;
+
+                                   if (isxdigit( p[1] ))
+                                        hex[1] = *++p;
+                              }
+
+                              c = strtol( hex, NULL, 16 );
+                              break;
+                         }
+                         default:
+                              c = *p;
+                              break;
+                    }
+               }
+
+               frame_append( frame, &c, 1 );
+          }
+     }
+
+     return 0;
+}
+
+/* Recordings made with --record, each update is a frame */
+static int script_load_record( Script *script, const char *filename )
+{
+     int         ret;
+     const char *buffer;
+     size_t      count;
+     Frame      *frame  = NULL;
+     TermRecord *record = term_record_open( filename, 1 );
+
+     if (!record)
+          return -1;
+
+     while ((ret = term_record_read( record, &buffer, &count )) > 0) {
+          if (!count) {
+               frame = NULL;
+               continue;
+          }
+
+          if (!frame)
+               frame = script_add_frame( script );
+
+          frame_append( frame, buffer, count );
+     }
+
+     term_record_close( record );
+
+     return ret;
+}
+
+static int script_load( Script *script, const char *filename )
+{
+     FILE *f;
+     char  magic[8];
+     int   ret;
+
+     memset( script, 0, sizeof(Script) );
+
+     f = fopen( filename, "rb" );
+     if (!f) {
+          perror( filename );
+          return -1;
+     }
+
+     if (fread( magic, 1, 8, f ) == 8 && !memcmp( magic, TERM_RECORD_MAGIC, 8 )) {
+          fclose( f );
+          return script_load_record( script, filename );
+     }
+
+     rewind( f );
+
+     ret = script_load_text( script, f );
+
+     fclose( f );
+
+     return ret;
+}
+
+static void script_free( Script *script )
+{
+     int i;
+
+     for (i = 0; i < script->num; i++)
+          free( script->frames[i].data );
+
+     free( script->frames );
+}
+
+/**********************************************************************************************************************/
+
+#ifdef USE_LIBTSM
+static void tsm_vte_write( struct tsm_vte* vte, const char *buffer, size_t count, void *user_data )
+{
+     /* Nothing to answer to */
+}
+#endif
+
+static unsigned long long surface_hash( IDirectFBSurface *surface )
+{
+     int                 x, y, width, height, pitch;
+     void               *data;
+     unsigned long long  hash = FNV_OFFSET;
+
+     surface->GetSize( surface, &width, &height );
+
+     if (surface->Lock( surface, DSLF_READ, &data, &pitch ))
+          return 0;
+
+     for (y = 0; y < height; y++) {
+          const u8 *row = data + y * pitch;
+
+          for (x = 0; x < width * 4; x++) {
+               hash ^= row[x];
+               hash *= FNV_PRIME;
+          }
+     }
+
+     surface->Unlock( surface );
+
+     return hash;
+}
+
+static int term_open( Term *term, IDirectFBFont *font, int cols, int rows )
+{
+     DFBResult             ret;
+     DFBSurfaceDescription desc;
+
+     memset( term, 0, sizeof(Term) );
+
+     term->font = font;
+
+     term->font->GetGlyphExtents( term->font, 'O', NULL, &term->CW );
+     term->font->GetHeight( term->font, &term->CH );
+
+     term->width  = term->CW * cols;
+     term->height = term->CH * rows;
+
+     /* Offscreen surface in system memory, to get the same pixels on every machine */
+     desc.flags       = DSDESC_CAPS | DSDESC_WIDTH | DSDESC_HEIGHT | DSDESC_PIXELFORMAT;
+     desc.caps        = DSCAPS_SYSTEMONLY;
+     desc.width       = term->width;
+     desc.height      = term->height;
+     desc.pixelformat = DSPF_ARGB;
+
+     ret = dfb->CreateSurface( dfb, &desc, &term->surface );
+     if (ret) {
+          DirectFBError( "CreateSurface() failed", ret );
+          return -1;
+     }
+
+     term->surface->SetFont( term->surface, term->font );
+
+     term->snapshots = term_snapshots_create();
+     if (!term->snapshots)
+          return -1;
+
+#ifdef USE_LIBTSM
+     if (tsm_screen_new( &term->screen, NULL, term ) || tsm_vte_new( &term->vte, term->screen, tsm_vte_write, term, NULL, term ))
+          return -1;
+     else {
+          struct tsm_screen_attr attr;
+          tsm_vte_get_def_attr( term->vte, &attr );
+          term->surface->Clear( term->surface, attr.br, attr.bg, attr.bb, TERM_BGALPHA );
+     }
+
+     tsm_screen_set_max_sb( term->screen, TERM_LINES );
+
+     tsm_screen_resize( term->screen, cols, rows );
+#else
+     term->vtx = vtx_new( cols, rows, term );
+     if (!term->vtx)
+          return -1;
+
+     term->surface->Clear( term->surface, default_red[17], default_grn[17], default_blu[17], TERM_BGALPHA );
+
+     vt_scrollback_set( &term->vtx->vt, TERM_LINES );
+#endif
+
+     return 0;
+}
+
+static void term_close( Term *term )
+{
+#ifdef USE_LIBTSM
+     if (term->vte)
+          tsm_vte_unref( term->vte );
+
+     if (term->screen)
+          tsm_screen_unref( term->screen );
+#else
+     if (term->vtx)
+          vtx_destroy( term->vtx );
+#endif
+
+     term_snapshots_destroy( term->snapshots );
+
+     free( term->shown );
+     free( term->shown_ids );
+
+     if (term->surface)
+          term->surface->Release( term->surface );
+}
+
+/* Same sequence of calls as the update and render threads of the terminal for one burst of output */
+static void term_frame( Term *term, Frame *frame )
+{
+     TermSnapshot *snapshot;
+
+#ifdef USE_LIBTSM
+     tsm_vte_input( term->vte, frame->data, frame->size );
+
+     snapshot = term_snapshots_begin( term->snapshots,
+                                      tsm_screen_get_width( term->screen ), tsm_screen_get_height( term->screen ) );
+     if (snapshot)
+          term_snapshot_compose( term->snapshots, snapshot, term->screen );
+#else
+     vt_parse_vt( &term->vtx->vt, frame->data, frame->size );
+
+     snapshot = term_snapshots_begin( term->snapshots, term->vtx->vt.width, term->vtx->vt.height );
+     if (snapshot)
+          term_snapshot_compose( term->snapshots, snapshot, term->vtx );
+
+#ifdef ZVT_LINE_RING
+     vt_scrollback_pack( &term->vtx->vt );
+#endif
+#endif
+
+     if (snapshot) {
+          term_snapshots_publish( term->snapshots );
+
+          term_draw_snapshot( term, term_snapshots_acquire( term->snapshots ) );
+     }
+
+     term->flip_pending = DFB_FALSE;
+}
+
+/**********************************************************************************************************************/
+
+/* Returns 0 if all frames match, 1 on mismatch, 77 if there is no golden file, -1 on error */
+static int check_script( const char *filename, IDirectFBFont *font, int cols, int rows, int update )
+{
+     int                 i, ret = 0;
+     char                golden[strlen( filename ) + sizeof("." BACKEND ".golden")];
+     unsigned long long  hash, expected;
+     FILE               *f;
+     Script              script;
+     Term                term;
+
+     if (script_load( &script, filename ))
+          return -1;
+
+     snprintf( golden, sizeof(golden), "%s." BACKEND ".golden", filename );
+
+     f = fopen( golden, update ? "w" : "r" );
+     if (!f) {
+          if (update) {
+               perror( golden );
+               script_free( &script );
+               return -1;
+          }
+
+          ret = 77;
+     }
+
+     if (term_open( &term, font, cols, rows )) {
+          term_close( &term );
+          script_free( &script );
+          return -1;
+     }
+
+     for (i = 0; i < script.num; i++) {
+          term_frame( &term, &script.frames[i] );
+
+          hash = surface_hash( term.surface );
+
+          if (update)
+               fprintf( f, "%016llx\n", hash );
+          else if (ret == 77)
+               printf( "%s: frame %d %016llx\n", filename, i, hash );
+          else if (fscanf( f, "%llx", &expected ) != 1 || expected != hash) {
+               printf( "%s: frame %d differs (%016llx)\n", filename, i, hash );
+               ret = 1;
+          }
+     }
+
+     if (ret == 77)
+          printf( "%s: no golden file, skipped\n", filename );
+     else if (!ret)
+          printf( "%s: %d frames %s\n", filename, script.num, update ? "written" : "match" );
+
+     if (f)
+          fclose( f );
+
+     term_close( &term );
+
+     script_free( &script );
+
+     return ret;
+}
+
+static void check_usage()
+{
+     printf( "DFBTerm rendering regression check (" BACKEND ")\n\n" );
+     printf( "Usage: render-check [options] scripts...\n\n" );
+     printf( "Every frame of a script is drawn to an offscreen surface and its hash is compared\n" );
+     printf( "with the one stored in <script>." BACKEND ".golden.\n\n" );
+     printf( "Options:\n\n" );
+     printf( "  --size=<cols>x<rows>  Set terminal size (default = %dx%d).\n", TERM_DEFAULT_COLS, TERM_DEFAULT_ROWS );
+     printf( "  --fontsize=<size>     Set font size (default = %d).\n", TERM_DEFAULT_FONTSIZE );
+     printf( "  --font=<file>         Load the font from file (default = %s/%s.dgiff).\n", TERMFONTDIR, TERM_FONT );
+     printf( "  --update              Write the golden files instead of checking them.\n" );
+     printf( "  --help                Print usage information.\n" );
+}
+
+int main( int argc, char *argv[] )
+{
+     DFBResult           ret;
+     int                 i;
+     int                 cols     = TERM_DEFAULT_COLS;
+     int                 rows     = TERM_DEFAULT_ROWS;
+     int                 fontsize = TERM_DEFAULT_FONTSIZE;
+     int                 update   = 0;
+     const char         *fontfile = NULL;
+     int                 checked  = 0;
+     int                 result   = 0;
+     int                 len      = strlen( TERMFONTDIR ) + 1 + strlen( TERM_FONT ) + 6 + 1;
+     char                filename[len];
+     DFBFontDescription  desc;
+     IDirectFBFont      *font;
+
+     ret = DirectFBInit( &argc, &argv );
+     if (ret) {
+          DirectFBError( "DirectFBInit() failed", ret );
+          return 1;
+     }
+
+     /* Headless by default */
+     if (!getenv( "DFBARGS" ))
+          DirectFBSetOption( "system", "dummy" );
+
+     for (i = 1; i < argc; i++) {
+          if (!strcmp( argv[i], "--help" )) {
+               check_usage();
+               return 0;
+          }
+          else if (strstr( argv[i], "--size=" ) == argv[i]) {
+               if (sscanf( argv[i] + 7, "%dx%d", &cols, &rows ) != 2 || cols < 1 || rows < 1) {
+                    DirectFBError( "Bad size format", DFB_FAILURE );
+                    return 1;
+               }
+          }
+          else if (strstr( argv[i], "--fontsize=" ) == argv[i]) {
+               fontsize = atoi( argv[i] + 11 );
+          }
+          else if (strstr( argv[i], "--font=" ) == argv[i]) {
+               fontfile = argv[i] + 7;
+          }
+          else if (!strcmp( argv[i], "--update" )) {
+               update = 1;
+          }
+     }
+
+     ret = DirectFBCreate( &dfb );
+     if (ret) {
+          DirectFBError( "DirectFBCreate() failed", ret );
+          return 1;
+     }
+
+     desc.flags  = DFDESC_HEIGHT;
+     desc.height = fontsize;
+
+     /* The test passes the font of the source tree, so that it does not depend on the installed one */
+     if (fontfile) {
+          ret = dfb->CreateFont( dfb, fontfile, &desc, &font );
+     }
+     else {
+          snprintf( filename, len, TERMFONTDIR"/%s.dgiff", TERM_FONT );
+          ret = dfb->CreateFont( dfb, filename, &desc, &font );
+          if (ret) {
+               snprintf( filename, len, TERMFONTDIR"/%s.ttf", TERM_FONT );
+               ret = dfb->CreateFont( dfb, filename, &desc, &font );
+          }
+     }
+
+     if (ret) {
+          DirectFBError( "CreateFont() failed", ret );
+          dfb->Release( dfb );
+          return 1;
+     }
+
+     for (i = 1; i < argc; i++) {
+          int res;
+
+          if (argv[i][0] == '-')
+               continue;
+
+          res = check_script( argv[i], font, cols, rows, update );
+          if (res < 0 || res == 1)
+               result = 1;
+          else if (res == 0)
+               checked++;
+     }
+
+     font->Release( font );
+
+     dfb->Release( dfb );
+
+     /* Tell the test runner that nothing could be compared */
+     if (!result && !checked)
+          return 77;
+
+     return result;
+}
@@ -0,0 +1,152 @@
+/*
+   This file is part of DFBTerm.
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along
+   with this program; if not, write to the Free Software Foundation, Inc.,
+   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA
+*/
+
+#include <config.h>
+#include <bench.h>
+#include <libzvt/vtx.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**********************************************************************************************************************/
+
+#define DEFAULT_ITERATIONS 5
+
+static void parse_corpus( struct _vtx *vx, const BenchCorpus *corpus )
+{
+     size_t offset;
+
+     for (offset = 0; offset < corpus->size; offset += BENCH_CHUNK_SIZE) {
+          size_t length = corpus->size - offset;
+
+          if (length > BENCH_CHUNK_SIZE)
+               length = BENCH_CHUNK_SIZE;
+
+          vt_parse_vt( &vx->vt, corpus->data + offset, length );
+     }
+}
+
+static void run_corpus( const BenchCorpus *corpus, int cols, int rows, int iterations )
+{
+     int          i;
+     long long    t, best = 0;
+     struct _vtx *vx;
+
+     vx = vtx_new( cols, rows, NULL );
+
+     vt_scrollback_set( &vx->vt, BENCH_DEFAULT_LINES );
+
+     /* Warm up caches and fill the scrollback, so that every timed run does the same work */
+     parse_corpus( vx, corpus );
+
+     for (i = 0; i < iterations; i++) {
+          t = bench_now();
+
+          parse_corpus( vx, corpus );
+
+          t = bench_now() - t;
+
+          if (!best || t < best)
+               best = t;
+     }
+
+     vtx_destroy( vx );
+
+     if (!best)
+          best = 1;
+
+     printf( "%-16s %10zu %10.2f %8.2f\n",
+             corpus->name, corpus->size, corpus->size * 1000.0 / best, (double) best / corpus->size );
+}
+
+static void bench_usage()
+{
+     printf( "vt_parse_vt throughput benchmark\n\n" );
+     printf( "Usage: bench-vt-parse [options] [files...]\n\n" );
+     printf( "Without files, the built-in corpora are generated.\n\n" );
+     printf( "Options:\n\n" );
+     printf( "  --size=<cols>x<rows>  Set terminal size (default = %dx%d).\n", BENCH_DEFAULT_COLS, BENCH_DEFAULT_ROWS );
+     printf( "  --iterations=<n>      Set number of timed runs, the best one is reported (default = %d).\n",
+             DEFAULT_ITERATIONS );
+     printf( "  --corpus-size=<kB>    Set size of the generated corpora (default = %d).\n",
+             BENCH_DEFAULT_CORPUS_SIZE / 1024 );
+     printf( "  --help                Print usage information.\n" );
+}
+
+int main( int argc, char *argv[] )
+{
+     int         i;
+     int         cols       = BENCH_DEFAULT_COLS;
+     int         rows       = BENCH_DEFAULT_ROWS;
+     int         iterations = DEFAULT_ITERATIONS;
+     size_t      size       = BENCH_DEFAULT_CORPUS_SIZE;
+     int         files      = 0;
+     BenchCorpus corpus;
+
+     for (i = 1; i < argc; i++) {
+          if (!strcmp( argv[i], "--help" )) {
+               bench_usage();
+               return 0;
+          }
+          else if (strstr( argv[i], "--size=" ) == argv[i]) {
+               if (bench_parse_size( 1 + strchr( argv[i], '=' ), &cols, &rows ))
+                    return 1;
+          }
+          else if (strstr( argv[i], "--iterations=" ) == argv[i]) {
+               iterations = atoi( 1 + strchr( argv[i], '=' ) );
+               if (iterations < 1)
+                    iterations = 1;
+          }
+          else if (strstr( argv[i], "--corpus-size=" ) == argv[i]) {
+               size = atoi( 1 + strchr( argv[i], '=' ) ) * 1024;
+          }
+          else if (argv[i][0] == '-') {
+               bench_usage();
+               return 1;
+          }
+          else
+               files++;
+     }
+
+     printf( "%-16s %10s %10s %8s\n", "corpus", "bytes", "MB/s", "ns/byte" );
+
+     if (files) {
+          for (i = 1; i < argc; i++) {
+               if (argv[i][0] == '-')
+                    continue;
+
+               if (bench_corpus_load( &corpus, argv[i] ))
+                    return 1;
+
+               run_corpus( &corpus, cols, rows, iterations );
+
+               bench_corpus_free( &corpus );
+          }
+     }
+     else {
+          for (i = 0; bench_corpus_names[i]; i++) {
+               bench_corpus_generate( &corpus, bench_corpus_names[i], size );
+
+               run_corpus( &corpus, cols, rows, iterations );
+
+               bench_corpus_free( &corpus );
+          }
+     }
+
+     return 0;
+}
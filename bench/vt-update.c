@@ -0,0 +1,173 @@
+/*
+   This file is part of DFBTerm.
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along
+   with this program; if not, write to the Free Software Foundation, Inc.,
+   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA
+*/
+
+#include <config.h>
+#include <bench.h>
+#include <bench-draw.h>
+#include <libzvt/vtx.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**********************************************************************************************************************/
+
+/* Cell size of the default font at the default font size */
+#define DEFAULT_CELL_WIDTH   8
+#define DEFAULT_CELL_HEIGHT 16
+
+static void run_corpus( const BenchCorpus *corpus, int cols, int rows, int CW, int CH, int full )
+{
+     size_t         offset;
+     unsigned long  frames = 0;
+     long long      t;
+     struct _vtx   *vtx;
+     TermSnapshots *snapshots;
+     TermSnapshot  *snapshot;
+     BenchDraw      draw;
+
+     memset( &draw, 0, sizeof(draw) );
+
+     vtx = vtx_new( cols, rows, NULL );
+
+     vt_scrollback_set( &vtx->vt, BENCH_DEFAULT_LINES );
+
+     snapshots = term_snapshots_create();
+
+     t = bench_now();
+
+     /* Each chunk is one frame, as if it was returned by a single read() in term_update(), and drawn right away */
+     for (offset = 0; offset < corpus->size; offset += BENCH_CHUNK_SIZE) {
+          size_t length = corpus->size - offset;
+
+          if (length > BENCH_CHUNK_SIZE)
+               length = BENCH_CHUNK_SIZE;
+
+          vt_parse_vt( &vtx->vt, corpus->data + offset, length );
+
+          /* Same sequence as term_redraw() and term_render() */
+          snapshot = term_snapshots_begin( snapshots, cols, rows );
+
+          term_snapshot_compose( snapshots, snapshot, vtx );
+
+          term_snapshots_publish( snapshots );
+
+          vt_scrollback_pack( &vtx->vt );
+
+          if (full)
+               bench_draw_invalidate( &draw );
+
+          bench_draw_snapshot( &draw, term_snapshots_acquire( snapshots ) );
+
+          frames++;
+     }
+
+     t = bench_now() - t;
+
+     term_snapshots_destroy( snapshots );
+
+     bench_draw_free( &draw );
+
+     vtx_destroy( vtx );
+
+     if (!frames)
+          return;
+
+     printf( "%-16s %-7s %7lu %9.1f %9.1f %10.1f %8.2f %10.1f %8.2f %9.1f\n",
+             corpus->name, full ? "full" : "changes", frames,
+             (double) draw.draw_calls   / frames,
+             (double) draw.draw_cells   / frames,
+             (double) draw.draw_cells   * CW * CH / frames / 1000,
+             (double) draw.scroll_calls / frames,
+             (double) draw.scroll_rows  * CH * cols * CW / frames / 1000,
+             (double) draw.diff_rows    / frames,
+             t / 1000.0 / frames );
+}
+
+static void bench_usage()
+{
+     printf( "Snapshot draw-call benchmark, term_snapshot_compose() and the cell diff of term_draw_snapshot()\n\n" );
+     printf( "Usage: bench-vt-update [options] [files...]\n\n" );
+     printf( "Without files, the built-in corpora are generated.\n" );
+     printf( "Every %d bytes chunk is one frame, values are averages per frame.\n", BENCH_CHUNK_SIZE );
+     printf( "The full frames are drawn as if nothing was shown before.\n\n" );
+     printf( "Options:\n\n" );
+     printf( "  --size=<cols>x<rows>  Set terminal size (default = %dx%d).\n", BENCH_DEFAULT_COLS, BENCH_DEFAULT_ROWS );
+     printf( "  --cell=<w>x<h>        Set character cell size in pixels (default = %dx%d).\n",
+             DEFAULT_CELL_WIDTH, DEFAULT_CELL_HEIGHT );
+     printf( "  --corpus-size=<kB>    Set size of the generated corpora (default = %d).\n",
+             BENCH_DEFAULT_CORPUS_SIZE / 1024 );
+     printf( "  --help                Print usage information.\n" );
+}
+
+int main( int argc, char *argv[] )
+{
+     int         i;
+     int         cols  = BENCH_DEFAULT_COLS;
+     int         rows  = BENCH_DEFAULT_ROWS;
+     int         CW    = DEFAULT_CELL_WIDTH;
+     int         CH    = DEFAULT_CELL_HEIGHT;
+     size_t      size  = BENCH_DEFAULT_CORPUS_SIZE;
+     int         files = 0;
+     BenchCorpus corpus;
+
+     for (i = 1; i < argc; i++) {
+          if (!strcmp( argv[i], "--help" )) {
+               bench_usage();
+               return 0;
+          }
+          else if (strstr( argv[i], "--size=" ) == argv[i]) {
+               if (bench_parse_size( 1 + strchr( argv[i], '=' ), &cols, &rows ))
+                    return 1;
+          }
+          else if (strstr( argv[i], "--cell=" ) == argv[i]) {
+               if (bench_parse_size( 1 + strchr( argv[i], '=' ), &CW, &CH ))
+                    return 1;
+          }
+          else if (strstr( argv[i], "--corpus-size=" ) == argv[i]) {
+               size = atoi( 1 + strchr( argv[i], '=' ) ) * 1024;
+          }
+          else if (argv[i][0] == '-') {
+               bench_usage();
+               return 1;
+          }
+          else
+               files++;
+     }
+
+     printf( "%-16s %-7s %7s %9s %9s %10s %8s %10s %8s %9s\n", "corpus", "draw", "frames",
+             "draws", "cells", "draw kpix", "scrolls", "scrl kpix", "rows", "us/frame" );
+
+     for (i = 0; files ? i < argc : bench_corpus_names[i] != NULL; i++) {
+          if (files) {
+               if (i == 0 || argv[i][0] == '-')
+                    continue;
+
+               if (bench_corpus_load( &corpus, argv[i] ))
+                    return 1;
+          }
+          else
+               bench_corpus_generate( &corpus, bench_corpus_names[i], size );
+
+          run_corpus( &corpus, cols, rows, CW, CH, 0 );
+          run_corpus( &corpus, cols, rows, CW, CH, 1 );
+
+          bench_corpus_free( &corpus );
+     }
+
+     return 0;
+}
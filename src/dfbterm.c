@@ -17,162 +17,118 @@
 */
 
 #include <config.h>
-#include <direct/thread.h>
-#include <directfb.h>
 #include <directfb_util.h>
 #ifdef USE_LIBTSM
-#include <libtsm.h>
 #include <shl-pty.h>
 #include <sys/wait.h>
-#else
-#include <libzvt/vtx.h>
 #endif
 #include <lite/lite.h>
-#include <lite/window.h>
 #include <pwd.h>
+#include <term.h>
 
 /**********************************************************************************************************************/
 
-#define TERM_FONT    "Misc-Fixed"
-#define TERM_BGALPHA  0xe0
-#define TERM_LINES    4000
-
-#define TERM_DEFAULT_FONTSIZE  13
-#define TERM_DEFAULT_COLS     100
-#define TERM_DEFAULT_ROWS      30
-
-typedef struct {
-     IDirectFBFont              *font;
-     int                         CW, CH;
-     int                         width, height;
-     LiteWindow                 *window;
-     IDirectFBSurface           *surface;
-     IDirectFBSurface           *bar_surface;
-     int                         bar_start, bar_end;
-
-#ifdef USE_LIBTSM
-     struct tsm_screen          *screen;
-     struct tsm_vte             *vte;
-     struct shl_pty             *pty;
-     int                         pty_bridge;
-     pid_t                       pid;
-     tsm_age_t                   age;
-     int                         selected;
-     int                         selectiontype;
-     IDirectFBSurface           *image;
-     int                         image_x, image_y;
-#else
-     struct _vtx                *vtx;
-#endif
-
-     DirectThread               *update_thread;
-     bool                        update_closing;
-     DirectMutex                 lock;
-
-     int                         cursor_state;
-
-     DFBRegion                   flip_region;
-     DFBBoolean                  flip_pending;
-
-     DFBBoolean                  in_resize;
-
-     struct timeval              last_click;
-} Term;
-
 #ifdef USE_LIBTSM
-
 #define VT_SELTYPE_NONE  0
 #define VT_SELTYPE_CHAR  1
 #define VT_SELTYPE_WORD  2
 #define VT_SELTYPE_MOVED 0x2000
+#endif
 
-#else
+static inline long long term_now( Term *term )
+{
+     return term->stats ? term_stats_now() : 0;
+}
 
-/* The first 16 values are the ANSI colors, the last two are the default foreground and default background */
+static unsigned int term_flip_area( Term *term )
+{
+     if (!term->flip_pending)
+          return 0;
 
-static const u8 default_red[] = {
-     0x00, 0xaa, 0x00, 0xaa, 0x00, 0xaa, 0x00, 0xbb, 0x77, 0xff, 0x55, 0xff, 0x55, 0xff, 0x55, 0xff, 0xb0, 0x00
-};
+     return (term->flip_region.x2 - term->flip_region.x1 + 1) * (term->flip_region.y2 - term->flip_region.y1 + 1);
+}
 
-static const u8 default_grn[] = {
-     0x00, 0x00, 0xaa, 0x55, 0x00, 0x00, 0xaa, 0xbb, 0x77, 0x55, 0xff, 0xff, 0x55, 0x55, 0xff, 0xff, 0xb0, 0x00
-};
+static void term_trace_key( Term *term, DFBWindowEvent *evt )
+{
+     if (!term->stats)
+          return;
 
-static const u8 default_blu[] = {
-     0x00, 0x00, 0x00, 0x00, 0xaa, 0xaa, 0xaa, 0xbb, 0x77, 0x55, 0x55, 0x55, 0xff, 0xff, 0xff, 0xff, 0xb0, 0x00
-};
+     direct_mutex_lock( &term->render_lock );
 
-#endif
+     term_stats_key( term->stats, term_stats_timeval( &evt->timestamp ), term_stats_now() );
 
-/**********************************************************************************************************************/
+     direct_mutex_unlock( &term->render_lock );
+}
 
-static void add_flip( Term *term, DFBRegion *region )
+#ifdef USE_LIBTSM
+/* Images from OSC strings are drawn over the terminal once */
+static void term_draw_image( Term *term, TermSnapshot *snapshot )
 {
-     if (term->flip_pending) {
-          if (term->flip_region.x1 > region->x1)
-               term->flip_region.x1 = region->x1;
+     int          image_width, image_height;
+     DFBRectangle rect;
+     DFBRegion    region;
 
-          if (term->flip_region.y1 > region->y1)
-               term->flip_region.y1 = region->y1;
+     if (!snapshot->image)
+          return;
 
-          if (term->flip_region.x2 < region->x2)
-               term->flip_region.x2 = region->x2;
+     snapshot->image->GetSize( snapshot->image, &image_width, &image_height );
 
-          if (term->flip_region.y2 < region->y2)
-               term->flip_region.y2 = region->y2;
+     if (image_width > term->width || image_height > term->height) {
+          if (image_width * term->height > image_height * term->width) {
+               rect.w = term->width;
+               rect.h = image_height * term->width / image_width;
+          } else {
+               rect.h = term->height;
+               rect.w = image_width * term->height / image_height;
+          }
      }
      else {
-          term->flip_region  = *region;
-          term->flip_pending = DFB_TRUE;
+          rect.w = image_width;
+          rect.h = image_height;
      }
-}
 
-static void term_flush_flip( Term *term )
-{
-     if (!term->flip_pending)
-          return;
+     rect.x = snapshot->image_x >= 0 ? snapshot->image_x : (term->width  - rect.w) >> 1;
+     rect.y = snapshot->image_y >= 0 ? snapshot->image_y : (term->height - rect.h) >> 1;
 
-#ifdef USE_LIBTSM
-     if (term->image) {
-          int          image_width, image_height;
-          DFBRectangle rect;
-          DFBRegion    region;
-
-          term->image->GetSize( term->image, &image_width, &image_height );
-
-          if (image_width > term->width || image_height > term->height) {
-               if (image_width * term->height > image_height * term->width) {
-                    rect.w = term->width;
-                    rect.h = image_height * term->width / image_width;
-               } else {
-                    rect.h = term->height;
-                    rect.w = image_width * term->height / image_height;
-               }
-          }
-          else {
-               rect.w = image_width;
-               rect.h = image_height;
-          }
-
-          rect.x = term->image_x >= 0 ? term->image_x : (term->width  - rect.w) >> 1;
-          rect.y = term->image_y >= 0 ? term->image_y : (term->height - rect.h) >> 1;
+     term->surface->StretchBlit( term->surface, snapshot->image, NULL, &rect );
 
-          term->surface->StretchBlit( term->surface, term->image, NULL, &rect );
+     dfb_region_from_rectangle( &region, &rect );
 
-          dfb_region_from_rectangle( &region, &rect );
+     if (term->flip_pending)
           dfb_region_region_union( &term->flip_region, &region );
-
-          term->image->Release( term->image );
-          term->image = NULL;
+     else if (!term->in_resize) {
+          term->flip_region  = region;
+          term->flip_pending = DFB_TRUE;
      }
+
+     snapshot->image->Release( snapshot->image );
+     snapshot->image = NULL;
+}
 #endif
 
+static void term_flush_flip( Term *term )
+{
+     if (!term->flip_pending)
+          return;
+
      term->surface->Flip( term->surface, &term->flip_region,
                           getenv( "LITE_WINDOW_DOUBLEBUFFER" ) ? DSFLIP_BLIT : DSFLIP_NONE );
 
      term->flip_pending = DFB_FALSE;
 }
 
+/* OSC 52, once the data is complete */
+static void term_set_clipboard( Term *term )
+{
+     const char *data;
+     size_t      size;
+     IDirectFB  *dfb = lite_get_dfb_interface();
+
+     data = term_clipboard_end( term->clipboard, &size );
+     if (data)
+          dfb->SetClipboardData( dfb, "text/plain", data, size, NULL );
+}
+
 #ifdef USE_LIBTSM
 
 static void tsm_vte_write( struct tsm_vte* vte, const char *buffer, size_t count, void *user_data )
@@ -207,6 +163,12 @@ static void tsm_vte_osc( struct tsm_vte* vte, const char *osc, size_t len, void
                     if (dfb->CreateImageProvider( dfb, osc + 5, &image_provider ))
                          break;
 
+                    /* An image not drawn yet is replaced */
+                    if (term->image) {
+                         term->image->Release( term->image );
+                         term->image = NULL;
+                    }
+
                     image_provider->GetSurfaceDescription( image_provider, &desc );
                     dfb->CreateSurface( dfb, &desc, &term->image );
                     image_provider->RenderTo( image_provider, term->image, NULL );
@@ -221,266 +183,400 @@ static void tsm_vte_osc( struct tsm_vte* vte, const char *osc, size_t len, void
                osc = delim + 1;
           }
      }
+     else if (term->clipboard && !strncmp( osc, "52;", 3 )) {
+          term_clipboard_begin( term->clipboard );
+          term_clipboard_write( term->clipboard, osc + 3, len - 3 );
+
+          term_set_clipboard( term );
+     }
 }
 
-static int tsm_draw_cell( struct tsm_screen *screen, uint64_t id, const uint32_t *ch, size_t size, uint32_t len,
-                          uint32_t posx, uint32_t posy, const struct tsm_screen_attr *attr, tsm_age_t age, void *user_data )
+static void term_publish( Term *term );
+
+static void shl_pty_input( struct shl_pty *pty, void *user_data, char *buffer, size_t count )
 {
-     DFBRegion  region;
-     int        i, x, y, fga, bga;
-     u8         fr, fg, fb, br, bg, bb;
+     long long  t0;
      Term      *term = user_data;
 
-     if (age <= term->age)
-          return 0;
+     direct_mutex_lock( &term->lock );
 
-     fr = attr->fr;
-     fg = attr->fg;
-     fb = attr->fb;
-     br = attr->br;
-     bg = attr->bg;
-     bb = attr->bb;
+     if (term->record)
+          term_record_write( term->record, buffer, count );
 
-     if (attr->inverse) {
-          i = fr; fr = br; br = i;
-          i = fg; fg = bg; bg = i;
-          i = fb; fb = bb; bb = i;
+     t0 = term_now( term );
 
-          fga  = TERM_BGALPHA;
-          bga  = 0xff;
-     }
-     else {
-          fga  = 0xff;
-          bga  = TERM_BGALPHA;
-     }
+     if (!term->read_time)
+          term->read_time = t0;
 
-     x = posx * term->CW;
-     y = posy * term->CH;
+     tsm_vte_input( term->vte, buffer, count );
 
-     region.x1 = x;
-     region.y1 = y;
-     region.x2 = x + len * term->CW - 1;
-     region.y2 = y + term->CH - 1;
+     term->parse_time  += term_now( term ) - t0;
+     term->parse_bytes += count;
 
-     term->surface->SetColor( term->surface, br, bg, bb, bga );
+     term_publish( term );
 
-     term->surface->FillRectangle( term->surface, x, y, term->CW * len, term->CH );
+     if (term->record)
+          term_record_flush( term->record );
 
-     if (size) {
-          term->surface->SetColor( term->surface, fr, fg, fb, fga );
+     direct_mutex_unlock( &term->lock );
+}
 
-          term->surface->DrawGlyph( term->surface, *ch, x, y, DSTF_TOPLEFT );
-     }
+#endif
 
-     if (!term->in_resize)
-          add_flip( term, &region );
+/**********************************************************************************************************************/
 
-     return 0;
-}
+static void term_update_scrollbar( Term *term, const TermSnapshot *snapshot )
+{
+     int termrows, start, end, total;
 
-static void term_update_scrollbar( Term *term );
+     if (!term->bar_surface)
+          return;
 
-static void shl_pty_input( struct shl_pty *pty, void *user_data, char *buffer, size_t count )
-{
-     Term *term = user_data;
+     termrows = term->height / term->CH;
 
-     direct_mutex_lock( &term->lock );
+     total = snapshot->sb_lines + termrows;
+     start = snapshot->sb_pos * term->height / total;
+     end   = (snapshot->sb_pos + termrows) * term->height / total;
 
-     tsm_vte_input( term->vte, buffer, count );
+     if (!term->in_resize && start == term->bar_start && end == term->bar_end)
+          return;
 
-     term->age = tsm_screen_draw( term->screen, tsm_draw_cell, term );
+     if (start) {
+          term->bar_surface->SetColor( term->bar_surface, 0x00, 0x00, 0x00, TERM_BGALPHA );
+          term->bar_surface->FillRectangle( term->bar_surface, 0, 0, 2, start );
+     }
 
-     term_update_scrollbar( term );
+     if (end > start) {
+          term->bar_surface->SetColor( term->bar_surface, 0x80, 0x80, 0x80, TERM_BGALPHA );
+          term->bar_surface->FillRectangle( term->bar_surface, 0, start, 2, end - start );
+     }
 
-     term_flush_flip( term );
+     if (end < term->height) {
+          term->bar_surface->SetColor( term->bar_surface, 0x00, 0x00, 0x00, TERM_BGALPHA );
+          term->bar_surface->FillRectangle( term->bar_surface, 0, end, 2, term->height - end );
+     }
 
-     direct_mutex_unlock( &term->lock );
+     if (!term->in_resize)
+          term->bar_surface->Flip( term->bar_surface, NULL,
+                                   getenv( "LITE_WINDOW_DOUBLEBUFFER" ) ? DSFLIP_BLIT : DSFLIP_NONE );
+
+     term->bar_start = start;
+     term->bar_end   = end;
 }
 
-#else
+#ifndef USE_LIBTSM
+#ifdef ZVT_LINE_RING
+static size_t term_ring_memory( struct vt_ring *ring )
+{
+     size_t size = ring->size * sizeof(void*);
+     int    i;
 
-static int unichar_to_utf8( unsigned int c, char *s )
+     for (i = 0; i < ring->count; i++)
+          size += VT_LINE_SIZE( ((struct vt_line*) vt_ring_index( ring, i ))->width );
+
+     return size;
+}
+
+/* The slabs of the line pool, less the lines counted in the rings: the free lines and the unused part of the slabs */
+static size_t term_pool_memory( struct vt_em *vt )
 {
-     int len = 0;
-     int first;
-     int i;
+     size_t size = vt->pool.count * sizeof(struct vt_line_class);
+     size_t bytes;
+     int    i, width, used;
 
-     if (c < 0x80) {
-          first = 0;
-          len = 1;
-     }
-     else if (c < 0x800) {
-          first = 0xc0;
-          len = 2;
-     }
-     else if (c < 0x10000) {
-          first = 0xe0;
-          len = 3;
-     }
-     else if (c < 0x200000) {
-          first = 0xf0;
-          len = 4;
-     }
-     else if (c < 0x4000000) {
-          first = 0xf8;
-          len = 5;
-     }
-     else {
-          first = 0xfc;
-          len = 6;
-     }
+     for (i = 0; (bytes = vt_line_pool_class( vt, i, &width, &used )); i++)
+          size += bytes - used * VT_LINE_SIZE( width );
 
-     if (s) {
-          for (i = len - 1; i > 0; --i) {
-               s[i] = (c & 0x3f) | 0x80;
-               c >>= 6;
-          }
+     return size;
+}
+#else
+static size_t term_lines_memory( struct vt_list *list )
+{
+     size_t          size = 0;
+     struct vt_line *wn;
 
-          s[0] = c | first;
-     }
+     for (wn = (struct vt_line*) list->head; wn->next; wn = wn->next)
+          size += VT_LINE_SIZE( wn->width );
 
-     return len;
+     return size;
 }
+#endif
+#endif
 
-static void vt_draw_text( void *user_data, struct vt_line *line, int posy, int posx, int len, int attr )
+static void term_get_memory( Term *term, TermMemory *memory )
 {
-     DFBRegion  region;
-     int        i, n, x, y, fore, back, fga, bga;
-     char       text[len*6]; /* enough memory space for UTF-8 worst case */
-     Term      *term = user_data;
+#ifdef USE_LIBTSM
+     /* Estimate, each cell holds a symbol, its width and its attributes */
+     size_t line = tsm_screen_get_width( term->screen ) * (2 * sizeof(uint32_t) + sizeof(struct tsm_screen_attr));
 
-     fore = (attr & VTATTR_FORECOLOURM) >> VTATTR_FORECOLOURB;
-     back = (attr & VTATTR_BACKCOLOURM) >> VTATTR_BACKCOLOURB;
+     memory->scrollback_lines = tsm_screen_sb_get_line_count( term->screen );
+     memory->estimate         = 1;
 
-     if ((attr & VTATTR_BOLD) && fore < 8)
-          fore |= 8;
+     memory->bytes[TERM_MEMORY_SCROLLBACK] = line * memory->scrollback_lines;
+     memory->bytes[TERM_MEMORY_LINES]      = line * tsm_screen_get_height( term->screen );
+     memory->bytes[TERM_MEMORY_LINES_BACK] = 0;
+     memory->bytes[TERM_MEMORY_LINES_ALT]  = memory->bytes[TERM_MEMORY_LINES];
+     memory->bytes[TERM_MEMORY_POOL]       = 0;
+#else
+     memory->scrollback_lines = term->vtx->vt.scrollbacklines;
+     memory->estimate         = 0;
+
+#ifdef ZVT_LINE_RING
+     memory->bytes[TERM_MEMORY_SCROLLBACK] = term_ring_memory( &term->vtx->vt.scrollback );
+     memory->bytes[TERM_MEMORY_LINES]      = term_ring_memory( &term->vtx->vt.lines );
+     memory->bytes[TERM_MEMORY_LINES_BACK] = term_ring_memory( &term->vtx->vt.lines_back );
+     memory->bytes[TERM_MEMORY_LINES_ALT]  = term_ring_memory( &term->vtx->vt.lines_alt );
+     memory->bytes[TERM_MEMORY_POOL]       = term_pool_memory( &term->vtx->vt );
+#else
+     memory->bytes[TERM_MEMORY_SCROLLBACK] = term_lines_memory( &term->vtx->vt.scrollback );
+     memory->bytes[TERM_MEMORY_LINES]      = term_lines_memory( &term->vtx->vt.lines );
+     memory->bytes[TERM_MEMORY_LINES_BACK] = term_lines_memory( &term->vtx->vt.lines_back );
+     memory->bytes[TERM_MEMORY_LINES_ALT]  = term_lines_memory( &term->vtx->vt.lines_alt );
+     memory->bytes[TERM_MEMORY_POOL]       = 0;
+#endif
+#endif
+}
 
-     if (attr & VTATTR_REVERSE) {
-          i    = fore;
-          fore = back;
-          back = i;
+/* Called without the locks */
+static void term_poll_stats( Term *term )
+{
+     TermMemory memory;
 
-          fga  = TERM_BGALPHA;
-          bga  = 0xff;
-     }
-     else {
-          fga  = 0xff;
-          bga  = TERM_BGALPHA;
-     }
+     if (!term_stats_due( term->stats ))
+          return;
+
+     direct_mutex_lock( &term->lock );
 
-     x = posx * term->CW;
-     y = posy * term->CH;
+     term_get_memory( term, &memory );
 
-     region.x1 = x;
-     region.y1 = y;
-     region.x2 = x + len * term->CW - 1;
-     region.y2 = y + term->CH - 1;
+     direct_mutex_unlock( &term->lock );
 
-     term->surface->SetColor( term->surface, default_red[back], default_grn[back], default_blu[back], bga );
+     direct_mutex_lock( &term->render_lock );
 
-     term->surface->FillRectangle( term->surface, x, y, term->CW * len, term->CH );
+     term_stats_memory( term->stats, &memory );
 
-     term->surface->SetColor( term->surface, default_red[fore], default_grn[fore], default_blu[fore], fga );
+     term_stats_poll( term->stats );
 
-     for (i = 0, n = 0; i < len; i++) {
-          unsigned int c;
+     direct_mutex_unlock( &term->render_lock );
+}
 
-          c = VT_ASCII( line->data[i+posx] );
+/* Called with the render lock */
+static void term_update_hud( Term *term, bool force )
+{
+     int         i;
+     long long   now, elapsed;
+     TermMemory *memory = &term->hud_memory;
 
-          if (c < 128)
-               text[n++] = c;
-          else
-               n += unichar_to_utf8( c, text + n );
+     if (!term->hud_surface)
+          return;
+
+     now     = term_stats_now();
+     elapsed = now - term->hud_time;
+
+     /* Refresh the values once per second */
+     if (elapsed >= 1000000000LL) {
+          snprintf( term->hud_text[0], TERM_HUD_COLS + 1, "fps  %7.1f", term->hud_frames * 1000000000.0 / elapsed );
+          snprintf( term->hud_text[1], TERM_HUD_COLS + 1, "pty  %7.1f kB/s", term->hud_bytes * 1000000.0 / 1024 / elapsed );
+          snprintf( term->hud_text[2], TERM_HUD_COLS + 1, "draw %7.1f", term->hud_frames ?
+                    (double) term->hud_draws / term->hud_frames : 0.0 );
+          snprintf( term->hud_text[3], TERM_HUD_COLS + 1, "flip %7.1f kpx", term->hud_frames ?
+                    term->hud_area / 1000.0 / term->hud_frames : 0.0 );
+          snprintf( term->hud_text[4], TERM_HUD_COLS + 1, "sb   %7.1f kB", memory->bytes[TERM_MEMORY_SCROLLBACK] / 1024.0 );
+          snprintf( term->hud_text[5], TERM_HUD_COLS + 1, "scr  %7.1f kB", (memory->bytes[TERM_MEMORY_LINES] +
+                                                                            memory->bytes[TERM_MEMORY_LINES_BACK] +
+                                                                            memory->bytes[TERM_MEMORY_LINES_ALT]) / 1024.0 );
+          snprintf( term->hud_text[6], TERM_HUD_COLS + 1, "pool %7.1f kB", memory->bytes[TERM_MEMORY_POOL] / 1024.0 );
+
+          term_stats_memory( term->stats, memory );
+
+          term->hud_time   = now;
+          term->hud_frames = 0;
+          term->hud_draws  = 0;
+          term->hud_bytes  = 0;
+          term->hud_area   = 0;
      }
+     else if (!force)
+          return;
+
+     term->hud_surface->Clear( term->hud_surface, 0x00, 0x00, 0x00, TERM_BGALPHA );
+
+     term->hud_surface->SetColor( term->hud_surface, 0x80, 0xff, 0x80, 0xff );
 
-     term->surface->DrawString( term->surface, text, n, x, y, DSTF_TOPLEFT );
+     for (i = 0; i < TERM_HUD_LINES; i++)
+          term->hud_surface->DrawString( term->hud_surface, term->hud_text[i], -1, 0, i * term->CH, DSTF_TOPLEFT );
 
      if (!term->in_resize)
-          add_flip( term, &region );
+          term->hud_surface->Flip( term->hud_surface, NULL,
+                                   getenv( "LITE_WINDOW_DOUBLEBUFFER" ) ? DSFLIP_BLIT : DSFLIP_NONE );
 }
 
-static void vt_scroll_area( void *user_data, int firstrow, int count, int offset, int fill )
+/* Called with the lock, hands what is on the screen over to the renderer */
+static void term_publish( Term *term )
 {
-     DFBRegion     region;
-     DFBRectangle  rect;
-     Term         *term = user_data;
+     long long     now, t0;
+     TermSnapshot *snapshot;
 
-     rect.x = 0;
-     rect.y = (firstrow + offset) * term->CH;
-     rect.w = term->width;
-     rect.h = count * term->CH;
+     t0 = term_now( term );
 
-     term->surface->Blit( term->surface, term->surface, &rect, 0, firstrow * term->CH );
+#ifdef USE_LIBTSM
+     snapshot = term_snapshots_begin( term->snapshots,
+                                      tsm_screen_get_width( term->screen ), tsm_screen_get_height( term->screen ) );
+#else
+     snapshot = term_snapshots_begin( term->snapshots, term->vtx->vt.width, term->vtx->vt.height );
+#endif
+     if (!snapshot)
+          return;
 
-     region.x1 = 0;
-     region.x2 = term->width - 1;
-     region.y1 = firstrow * term->CH;
-     region.y2 = region.y1 + count * term->CH - 1;
+#ifdef USE_LIBTSM
+     term_snapshot_compose( term->snapshots, snapshot, term->screen );
 
-     if (!term->in_resize)
-          add_flip( term, &region );
-}
+     if (term->image) {
+          if (snapshot->image)
+               snapshot->image->Release( snapshot->image );
 
-static int vt_cursor_state( void *user_data, int state )
-{
-     Term *term = user_data;
+          snapshot->image   = term->image;
+          snapshot->image_x = term->image_x;
+          snapshot->image_y = term->image_y;
 
-     /* Only call vt_draw_cursor() if the state has changed */
-     if (term->cursor_state ^ state) {
-          vt_draw_cursor( term->vtx, state );
-          term->cursor_state = state;
+          term->image = NULL;
      }
+#else
+     term_snapshot_compose( term->snapshots, snapshot, term->vtx );
+#endif
 
-     return term->cursor_state;
-}
+     snapshot->bytes      += term->parse_bytes;
+     snapshot->parse_time += term->parse_time;
 
-#endif
+     if (!snapshot->read_time)
+          snapshot->read_time = term->read_time;
 
-/**********************************************************************************************************************/
+     term->parse_time  = 0;
+     term->parse_bytes = 0;
+     term->read_time   = 0;
+
+     /* The HUD shows the memory once per second */
+     if (term->hud_visible) {
+          now = term_stats_now();
+
+          if (now - term->memory_time >= 1000000000LL) {
+               term_get_memory( term, &snapshot->memory );
+
+               snapshot->has_memory = 1;
 
-static void term_update_scrollbar( Term *term )
+               term->memory_time = now;
+          }
+     }
+
+     snapshot->publish_time += term->publish_time + term_now( term ) - t0;
+
+     term->publish_time = 0;
+
+     term_snapshots_publish( term->snapshots );
+
+     direct_mutex_lock( &term->wake_lock );
+
+     direct_waitqueue_signal( &term->render_wq );
+
+     direct_mutex_unlock( &term->wake_lock );
+}
+
+/* Called with the render lock, draws the latest snapshot */
+static void term_render( Term *term )
 {
-     int termrows, start, end, total;
+     long long     t0, t1, t2;
+     unsigned int  area;
+     TermSnapshot *snapshot;
 
-     if (!term->bar_surface)
+     snapshot = term_snapshots_acquire( term->snapshots );
+     if (!snapshot)
           return;
 
-     termrows = term->height / term->CH;
+     if (snapshot->bytes)
+          term_stats_echo( term->stats, snapshot->read_time );
+
+     t0 = term_now( term );
+
+     term_draw_snapshot( term, snapshot );
+
+     term_update_scrollbar( term, snapshot );
+
+     t1   = term_now( term );
+     area = term_flip_area( term );
 
 #ifdef USE_LIBTSM
-     total = tsm_screen_sb_get_line_count( term->screen ) + termrows;
-     start = tsm_screen_sb_get_line_pos( term->screen ) * term->height / total;
-     end   = (tsm_screen_sb_get_line_pos( term->screen ) + termrows) * term->height / total;
-#else
-     total = term->vtx->vt.scrollbacklines + termrows;
-     start = (term->vtx->vt.scrollbacklines + term->vtx->vt.scrollbackoffset) * term->height / total;
-     end   = (term->vtx->vt.scrollbacklines + term->vtx->vt.scrollbackoffset + termrows) * term->height / total;
+     term_draw_image( term, snapshot );
 #endif
 
-     if (!term->in_resize && start == term->bar_start && end == term->bar_end)
-          return;
+     term_flush_flip( term );
 
-     if (start) {
-          term->bar_surface->SetColor( term->bar_surface, 0x00, 0x00, 0x00, TERM_BGALPHA );
-          term->bar_surface->FillRectangle( term->bar_surface, 0, 0, 2, start );
+     t2 = term_now( term );
+
+     /* Frames drawn for scrolling or selecting are not counted */
+     if (snapshot->bytes) {
+          term_stats_shown( term->stats, t2 );
+
+          term_stats_frame( term->stats, snapshot->bytes, snapshot->parse_time, snapshot->publish_time,
+                            t1 - t0, t2 - t1, area );
+
+          term->hud_frames++;
+          term->hud_bytes += snapshot->bytes;
+          term->hud_area  += area;
      }
 
-     if (end > start) {
-          term->bar_surface->SetColor( term->bar_surface, 0x80, 0x80, 0x80, TERM_BGALPHA );
-          term->bar_surface->FillRectangle( term->bar_surface, 0, start, 2, end - start );
+     if (snapshot->has_memory)
+          term->hud_memory = snapshot->memory;
+
+     term_update_hud( term, false );
+}
+
+static void *term_render_thread( DirectThread *thread, void *arg )
+{
+     Term *term = arg;
+
+     while (1) {
+          direct_mutex_lock( &term->wake_lock );
+
+          while (!term->render_closing && !term_snapshots_pending( term->snapshots ))
+               direct_waitqueue_wait( &term->render_wq, &term->wake_lock );
+
+          direct_mutex_unlock( &term->wake_lock );
+
+          if (term->render_closing)
+               break;
+
+          direct_mutex_lock( &term->render_lock );
+
+          term_render( term );
+
+          direct_mutex_unlock( &term->render_lock );
      }
 
-     if (end < term->height) {
-          term->bar_surface->SetColor( term->bar_surface, 0x00, 0x00, 0x00, TERM_BGALPHA );
-          term->bar_surface->FillRectangle( term->bar_surface, 0, end, 2, term->height - end );
+     return NULL;
+}
+
+static void term_toggle_hud( Term *term )
+{
+     direct_mutex_lock( &term->render_lock );
+
+     term->hud_visible = !term->hud_visible;
+
+     if (term->hud_visible) {
+          memset( term->hud_text, 0, sizeof(term->hud_text) );
+
+          term->hud_time   = term_stats_now();
+          term->hud_frames = 0;
+          term->hud_draws  = 0;
+          term->hud_bytes  = 0;
+          term->hud_area   = 0;
+
+          term->memory_time = 0;
      }
 
-     if (!term->in_resize)
-          term->bar_surface->Flip( term->bar_surface, NULL,
-                                   getenv( "LITE_WINDOW_DOUBLEBUFFER" ) ? DSFLIP_BLIT : DSFLIP_NONE );
+     direct_mutex_unlock( &term->render_lock );
 
-     term->bar_start = start;
-     term->bar_end   = end;
+     /* The HUD is placed on the right of the scroll bar, on_window_resize() handles the layout */
+     lite_resize_window( term->window, term->width + 2 + (term->hud_visible ? TERM_HUD_COLS * term->CW : 0),
+                         term->height );
 }
 
 static void term_handle_button( Term *term, DFBWindowEvent *evt )
@@ -571,15 +667,15 @@ static void term_handle_button( Term *term, DFBWindowEvent *evt )
 #ifdef USE_LIBTSM
           if (term->selected) {
                tsm_screen_selection_reset( term->screen );
-               term->age = tsm_screen_draw( term->screen, tsm_draw_cell, term );
                term->selected = 0;
+               term_publish( term );
           }
 #else
           if (term->vtx->selected) {
                term->vtx->selstartx = term->vtx->selendx;
                term->vtx->selstarty = term->vtx->selendy;
-               vt_draw_selection( term->vtx );
                term->vtx->selected = 0;
+               term_publish( term );
           }
 #endif
 
@@ -602,7 +698,7 @@ static void term_handle_button( Term *term, DFBWindowEvent *evt )
 
                     term->selected = 1;
 
-                    term->age = tsm_screen_draw( term->screen, tsm_draw_cell, term );
+                    term_publish( term );
 #else
                     if ((evt->modifiers & DIMM_CONTROL) || diff < 400000)
                          term->vtx->selectiontype = VT_SELTYPE_WORD | VT_SELTYPE_MOVED;
@@ -617,7 +713,8 @@ static void term_handle_button( Term *term, DFBWindowEvent *evt )
                     term->vtx->selendy   = term->vtx->selendyold   = posy + term->vtx->vt.scrollbackoffset;
 
                     vt_fix_selection( term->vtx );
-                    vt_draw_selection( term->vtx );
+
+                    term_publish( term );
 #endif
 
                     term->last_click = evt->timestamp;
@@ -654,7 +751,7 @@ static void term_handle_button( Term *term, DFBWindowEvent *evt )
 
                          tsm_screen_sb_reset( term->screen );
 
-                         term_update_scrollbar( term );
+                         term_publish( term );
 #else
                          unsigned int  i;
                          char         *buffer = clip_data;
@@ -668,11 +765,7 @@ static void term_handle_button( Term *term, DFBWindowEvent *evt )
                          if (term->vtx->vt.scrollbackoffset) {
                               term->vtx->vt.scrollbackoffset = 0;
 
-                              vt_update( term->vtx, UPDATE_SCROLLBACK );
-
-                              vt_cursor_state( term, 1 );
-
-                              term_update_scrollbar( term );
+                              term_publish( term );
                          }
 #endif
                     }
@@ -742,7 +835,6 @@ static void term_handle_motion( Term *term, DFBWindowEvent *evt )
           term->selectiontype |= VT_SELTYPE_MOVED;;
 
           tsm_screen_selection_target( term->screen, posx, posy );
-          term->age = tsm_screen_draw( term->screen, tsm_draw_cell, term );
 #else
           term->vtx->selectiontype |= VT_SELTYPE_MOVED;
 
@@ -750,8 +842,9 @@ static void term_handle_motion( Term *term, DFBWindowEvent *evt )
           term->vtx->selendy = posy + term->vtx->vt.scrollbackoffset;
 
           vt_fix_selection( term->vtx );
-          vt_draw_selection( term->vtx );
 #endif
+
+          term_publish( term );
      }
 }
 
@@ -809,10 +902,13 @@ static void term_handle_key( Term *term, DFBWindowEvent *evt )
      if ((evt->key_symbol > 9 && evt->key_symbol < 127) || (evt->key_symbol > 127 && evt->key_symbol < 256))
           c = evt->key_symbol;
 
-     if (evt->key_symbol != DIKS_ALT && evt->key_symbol != DIKS_CONTROL && evt->key_symbol != DIKS_SHIFT)
+     if (evt->key_symbol != DIKS_ALT && evt->key_symbol != DIKS_CONTROL && evt->key_symbol != DIKS_SHIFT) {
           if (!tsm_vte_handle_keyboard( term->vte, keysym, 0, mods, c ))
                return;
 
+          term_trace_key( term, evt );
+     }
+
      if (term->selected) {
           tsm_screen_selection_reset( term->screen );
           term->selected = 0;
@@ -820,9 +916,7 @@ static void term_handle_key( Term *term, DFBWindowEvent *evt )
 
      tsm_screen_sb_reset( term->screen );
 
-     term->age = tsm_screen_draw( term->screen, tsm_draw_cell, term );
-
-     term_update_scrollbar( term );
+     term_publish( term );
 #else
      if (evt->modifiers == DIMM_CONTROL && evt->key_symbol >= DIKS_SMALL_A && evt->key_symbol <= DIKS_SMALL_Z) {
           char c = evt->key_symbol - DIKS_SMALL_A + 1;
@@ -929,21 +1023,16 @@ static void term_handle_key( Term *term, DFBWindowEvent *evt )
           }
      }
 
-     if (term->vtx->selected) {
+     term_trace_key( term, evt );
+
+     if (term->vtx->selected || term->vtx->vt.scrollbackoffset) {
           term->vtx->selstartx = term->vtx->selendx;
           term->vtx->selstarty = term->vtx->selendy;
-          vt_draw_selection( term->vtx );
-          term->vtx->selected = 0;
-     }
+          term->vtx->selected  = 0;
 
-     if (term->vtx->vt.scrollbackoffset) {
           term->vtx->vt.scrollbackoffset = 0;
 
-          vt_update( term->vtx, UPDATE_SCROLLBACK );
-
-          vt_cursor_state( term, 1 );
-
-          term_update_scrollbar( term );
+          term_publish( term );
      }
 #endif
 }
@@ -977,8 +1066,6 @@ static void term_scroll( Term *term, int scroll )
           tsm_screen_sb_up( term->screen, -scroll );
      else
           tsm_screen_sb_down( term->screen, scroll );
-
-     term->age = tsm_screen_draw( term->screen, tsm_draw_cell, term );
 #else
      term->vtx->vt.scrollbackoffset += scroll;
 
@@ -986,16 +1073,90 @@ static void term_scroll( Term *term, int scroll )
           term->vtx->vt.scrollbackoffset = 0;
      else if (term->vtx->vt.scrollbackoffset < -term->vtx->vt.scrollbacklines)
           term->vtx->vt.scrollbackoffset = -term->vtx->vt.scrollbacklines;
+#endif
 
-     vt_update( term->vtx, UPDATE_SCROLLBACK );
+     term_publish( term );
+}
 
-     vt_cursor_state( term, 1 );
+/**********************************************************************************************************************/
+
+#ifndef USE_LIBTSM
+#ifdef VTOSC_STREAM
+/* OSC 52 data is decoded while it arrives */
+static int vt_handle_osc( void *user_data, int command, int event, const char *data, int len )
+{
+     Term *term = user_data;
+
+     if (command != 52 || !term->clipboard)
+          return VTOSC_IGNORE;
+
+     switch (event) {
+          case VTOSC_START:
+               term_clipboard_begin( term->clipboard );
+               return VTOSC_STREAM;
+
+          case VTOSC_DATA:
+               term_clipboard_write( term->clipboard, data, len );
+               break;
+
+          case VTOSC_END:
+               term_set_clipboard( term );
+               break;
+     }
+
+     return VTOSC_IGNORE;
+}
 #endif
 
-     term_update_scrollbar( term );
+static void term_input( Term *term, char *buffer, int count )
+{
+     long long t0;
+
+     direct_mutex_lock( &term->lock );
+
+     if (term->record)
+          term_record_write( term->record, buffer, count );
+
+     t0 = term_now( term );
+
+     if (!term->read_time)
+          term->read_time = t0;
+
+     vt_parse_vt( &term->vtx->vt, buffer, count );
+
+     term->parse_time  += term_now( term ) - t0;
+     term->parse_bytes += count;
+
+     direct_mutex_unlock( &term->lock );
 }
 
-/**********************************************************************************************************************/
+/* Ends an update, the renderer draws it while the parsing goes on */
+static void term_redraw( Term *term )
+{
+#ifdef ZVT_LINE_RING
+     long long t0;
+#endif
+
+     direct_mutex_lock( &term->lock );
+
+     term_publish( term );
+
+#ifdef ZVT_LINE_RING
+     t0 = term_now( term );
+
+     /* The lines scrolled out since the last frame are packed in a batch, the parsing only moves them */
+     vt_scrollback_pack( &term->vtx->vt );
+
+     /* Accounted with the next snapshot */
+     term->publish_time += term_now( term ) - t0;
+#endif
+
+     if (term->record)
+          term_record_flush( term->record );
+
+     direct_mutex_unlock( &term->lock );
+}
+#endif
 
 static void *term_update( DirectThread *thread, void *arg )
 {
@@ -1005,6 +1166,7 @@ static void *term_update( DirectThread *thread, void *arg )
           int            status;
 #ifndef USE_LIBTSM
           int            count, update = 0;
+          long long      published = 0;
           char           buffer[4096];
 #endif
           fd_set         set;
@@ -1018,7 +1180,8 @@ static void *term_update( DirectThread *thread, void *arg )
           FD_SET( term->vtx->vt.msgfd, &set );
 #endif
 
-          tv.tv_sec  = 10;
+          /* Wake up regularly to write the statistics and to refresh the HUD */
+          tv.tv_sec  = (term->stats || term->hud_visible) ? 1 : 10;
           tv.tv_usec = 0;
 
 #ifdef USE_LIBTSM
@@ -1035,8 +1198,20 @@ static void *term_update( DirectThread *thread, void *arg )
                break;
           }
 
-          if (status == 0)
+          term_poll_stats( term );
+
+          if (status == 0) {
+               /* The renderer refreshes the HUD with the new memory values */
+               if (term->hud_visible) {
+                    direct_mutex_lock( &term->lock );
+
+                    term_publish( term );
+
+                    direct_mutex_unlock( &term->lock );
+               }
+
                continue;
+          }
 
 #ifdef USE_LIBTSM
           if (waitpid( term->pid, &status, WNOHANG ) > 0) {
@@ -1053,28 +1228,96 @@ static void *term_update( DirectThread *thread, void *arg )
           }
 
           while ((count = read( term->vtx->vt.childfd, buffer, sizeof(buffer) )) > 0) {
-               vt_cursor_state( term, 0 );
+               term_input( term, buffer, count );
+
+               /* Keep the screen moving during a flood */
+               if (!update)
+                    published = term_stats_now();
+               else if (term_stats_now() - published >= TERM_PUBLISH_INTERVAL) {
+                    term_redraw( term );
+
+                    published = term_stats_now();
+               }
+
+               update = 1;
+          }
+
+          if (update)
+               term_redraw( term );
+#endif
+     }
+
+     return NULL;
+}
+
+static void *term_replay( DirectThread *thread, void *arg )
+{
+     int         ret;
+     const char *buffer;
+     size_t      count;
+     size_t      total  = 0;
+#ifndef USE_LIBTSM
+     int         update = 0;
+#endif
+     Term       *term   = arg;
+
+     /* Feed the recorded chunks with the same update granularity as the recorded session */
+     while ((ret = term_record_read( term->replay, &buffer, &count )) > 0) {
+          total += count;
+
+          term_poll_stats( term );
+
+#ifdef USE_LIBTSM
+          if (count)
+               shl_pty_input( NULL, term, (char*) buffer, count );
+#else
+          if (count) {
+               term_input( term, (char*) buffer, count );
 
                update = 1;
+          }
+          else if (update) {
+               term_redraw( term );
 
-               vt_parse_vt( &term->vtx->vt, buffer, count );
+               update = 0;
           }
+#endif
+     }
 
-          if (update) {
-               direct_mutex_lock( &term->lock );
+#ifndef USE_LIBTSM
+     if (update)
+          term_redraw( term );
+#endif
+
+     if (ret == 0) {
+          long long elapsed = term_record_elapsed( term->replay );
 
-               vt_update( term->vtx, UPDATE_CHANGES );
+          D_INFO( "DFBTerm: Replayed %zu bytes in %lld.%03lld ms\n", total, elapsed / 1000000, elapsed / 1000 % 1000 );
 
-               vt_cursor_state( term, 1 );
+          if (term->stats) {
+               TermMemory memory;
 
-               term_update_scrollbar( term );
+               direct_mutex_lock( &term->lock );
 
-               term_flush_flip( term );
+               term_get_memory( term, &memory );
 
                direct_mutex_unlock( &term->lock );
+
+               direct_mutex_lock( &term->render_lock );
+
+               term_stats_memory( term->stats, &memory );
+
+               term_stats_dump( term->stats, stderr );
+
+               direct_mutex_unlock( &term->render_lock );
           }
-#endif
      }
+     else
+          D_ERROR( "DFBTerm: Failed to read recording!\n" );
+
+     term->update_closing = true;
+
+     term->event_buffer->WakeUp( term->event_buffer );
 
      return NULL;
 }
@@ -1085,14 +1328,22 @@ static int on_window_resize( LiteWindow *window, int width, int height )
      int           termcols, termrows;
      Term         *term = LITE_BOX(window)->user_data;
 
+     /* Called with the lock, the renderer is kept off the surfaces while they are replaced */
+     direct_mutex_lock( &term->render_lock );
+
      term->in_resize = DFB_TRUE;
 
      if (term->bar_surface)
           term->bar_surface->Release( term->bar_surface );
 
+     if (term->hud_surface) {
+          term->hud_surface->Release( term->hud_surface );
+          term->hud_surface = NULL;
+     }
+
      term->surface->Release( term->surface );
 
-     term->width  = width - 2;
+     term->width  = width - 2 - (term->hud_visible ? TERM_HUD_COLS * term->CW : 0);
      term->height = height;
 
      termcols = term->width  / term->CW;
@@ -1108,24 +1359,39 @@ static int on_window_resize( LiteWindow *window, int width, int height )
      rect.x = term->width; rect.w = 2;
      window->box.surface->GetSubSurface( window->box.surface, &rect, &term->bar_surface );
 
+     /* Initialize sub area for HUD */
+     if (term->hud_visible) {
+          rect.x = term->width + 2; rect.w = TERM_HUD_COLS * term->CW;
+          window->box.surface->GetSubSurface( window->box.surface, &rect, &term->hud_surface );
+
+          term->hud_surface->SetFont( term->hud_surface, term->font );
+     }
+
 #ifdef USE_LIBTSM
      tsm_screen_resize( term->screen, termcols, termrows );
 
      shl_pty_resize( term->pty, termcols, termrows );
 #else
      vt_resize( &term->vtx->vt, termcols, termrows, term->width, term->height );
+#endif
 
-     vt_update_rect( term->vtx, 1, 0, 0, termcols, termrows );
+     /* Everything is drawn again, right away */
+     term_draw_invalidate( term );
 
-     vt_cursor_state( term, 1 );
-#endif
+     term->bar_start = -1;
+
+     term_publish( term );
+
+     term_render( term );
 
-     term_update_scrollbar( term );
+     term_update_hud( term, true );
 
      term->in_resize = DFB_FALSE;
 
      term->flip_pending = DFB_FALSE;
 
+     direct_mutex_unlock( &term->render_lock );
+
      return 1;
 }
 
@@ -1137,7 +1403,17 @@ static void term_usage()
      printf( "  --fontsize=<size>     Set font size (default = %d).\n", TERM_DEFAULT_FONTSIZE );
      printf( "  --size=<cols>x<rows>  Set terminal size (default = %dx%d).\n", TERM_DEFAULT_COLS, TERM_DEFAULT_ROWS );
      printf( "  --position=<x,y>      Set terminal position.\n" );
+     printf( "  --record=<file>       Record the terminal output to a file.\n" );
+     printf( "  --replay=<file>       Replay a recorded terminal output instead of starting a shell.\n" );
+     printf( "  --replay-fast         Replay as fast as possible instead of at original speed.\n" );
+     printf( "  --stats[=<file>]      Collect frame statistics, dumped on SIGUSR1 or written to a file every %d s.\n",
+             TERM_STATS_INTERVAL );
+     printf( "  --trace-latency       Add keystroke-to-screen latency to the statistics, dumped at exit.\n" );
+     printf( "  --report-memory       Print the memory used by the screen and scrollback buffers at exit.\n" );
+     printf( "  --clipboard-size=<kB> Limit the clipboard data set by applications through OSC 52, 0 to ignore it\n"
+             "                        (default = %d).\n", TERM_CLIPBOARD_DEFAULT_SIZE / 1024 );
      printf( "  --help                Print usage information.\n" );
+     printf( "\nPress Shift+F12 to toggle the performance HUD.\n" );
 }
 
 int main( int argc, char *argv[] )
@@ -1146,6 +1422,14 @@ int main( int argc, char *argv[] )
      int                   quit     = 0;
      char                 *geosep   = NULL;
      char                 *geometry = NULL;
+     char                 *record   = NULL;
+     char                 *replay   = NULL;
+     int                   fast     = 0;
+     int                   stats    = 0;
+     int                   latency  = 0;
+     int                   memory   = 0;
+     int                   clipsize = TERM_CLIPBOARD_DEFAULT_SIZE / 1024;
+     char                 *statfile = NULL;
      int                   fontsize = TERM_DEFAULT_FONTSIZE;
      int                   termcols = TERM_DEFAULT_COLS;
      int                   termrows = TERM_DEFAULT_ROWS;
@@ -1218,6 +1502,35 @@ int main( int argc, char *argv[] )
 
                termposx = atoi( geometry );
           }
+          else if (strstr( argv[i], "--record=" ) == argv[i]) {
+               record = 1 + index( argv[i], '=' );
+          }
+          else if (strstr( argv[i], "--replay=" ) == argv[i]) {
+               replay = 1 + index( argv[i], '=' );
+          }
+          else if (!strcmp( argv[i], "--replay-fast" )) {
+               fast = 1;
+          }
+          else if (!strcmp( argv[i], "--stats" )) {
+               stats = 1;
+          }
+          else if (strstr( argv[i], "--stats=" ) == argv[i]) {
+               stats    = 1;
+               statfile = 1 + index( argv[i], '=' );
+          }
+          else if (!strcmp( argv[i], "--trace-latency" )) {
+               latency = 1;
+          }
+          else if (!strcmp( argv[i], "--report-memory" )) {
+               memory = 1;
+          }
+          else if (strstr( argv[i], "--clipboard-size=" ) == argv[i]) {
+               clipsize = atoi( 1 + index( argv[i], '=' ) );
+               if (clipsize < 0 || clipsize > 1024 * 1024) {
+                    DirectFBError( "Invalid clipboard size", DFB_FAILURE );
+                    return 1;
+               }
+          }
      }
 
      /* Initialize */
@@ -1230,6 +1543,28 @@ int main( int argc, char *argv[] )
 
      term = D_CALLOC( 1, sizeof(Term) );
 
+     if (record) {
+          term->record = term_record_create( record );
+          if (!term->record) {
+               DirectFBError( "Failed to create recording", DFB_FAILURE );
+               goto out;
+          }
+     }
+
+     if (replay) {
+          term->replay = term_record_open( replay, fast );
+          if (!term->replay) {
+               DirectFBError( "Failed to open recording", DFB_FAILURE );
+               goto out;
+          }
+     }
+
+     if (stats || latency)
+          term->stats = term_stats_create( statfile, latency );
+
+     if (clipsize)
+          term->clipboard = term_clipboard_create( clipsize * 1024 );
+
      /* Load terminal font */
      desc.flags  = DFDESC_HEIGHT;
      desc.height = fontsize;
@@ -1311,6 +1646,8 @@ int main( int argc, char *argv[] )
      /* Create event buffer */
      lite_get_event_buffer( &event_buffer );
 
+     term->event_buffer = event_buffer;
+
 #ifdef USE_LIBTSM
      if (tsm_screen_new( &term->screen, NULL, term )) {
           DirectFBError( "Failed to create Screen object", DFB_FAILURE );
@@ -1344,16 +1681,18 @@ int main( int argc, char *argv[] )
 
      vt_scrollback_set( &term->vtx->vt, TERM_LINES );
 
-     term->vtx->draw_text    = vt_draw_text;
-     term->vtx->scroll_area  = vt_scroll_area;
-     term->vtx->cursor_state = vt_cursor_state;
-     term->vtx->scroll_type  = VT_SCROLL_SOMETIMES;
+#ifdef VTOSC_STREAM
+     term->vtx->vt.osc_handler = vt_handle_osc;
+#endif
 #endif
 
+     /* No child process when replaying */
+     if (term->replay)
+          i = 1;
 #ifdef USE_LIBTSM
-     if ((i = shl_pty_open( &term->pty, shl_pty_input, term, termcols, termrows )) == 0) {
+     else if ((i = shl_pty_open( &term->pty, shl_pty_input, term, termcols, termrows )) == 0) {
 #else
-     if ((i = vt_forkpty( &term->vtx->vt, 0 )) == 0) {
+     else if ((i = vt_forkpty( &term->vtx->vt, 0 )) == 0) {
 #endif
           char          *shell, *name;
           struct passwd *pw;
@@ -1383,20 +1722,40 @@ int main( int argc, char *argv[] )
      }
 
 #ifdef USE_LIBTSM
-     term->pty_bridge = shl_pty_bridge_new();
+     if (!term->replay) {
+          term->pty_bridge = shl_pty_bridge_new();
 
-     shl_pty_bridge_add( term->pty_bridge, term->pty );
+          shl_pty_bridge_add( term->pty_bridge, term->pty );
 
-     term->pid = shl_pty_get_child( term->pty );
+          term->pid = shl_pty_get_child( term->pty );
+     }
 
      tsm_screen_resize( term->screen, termcols, termrows );
 #endif
 
+     term->snapshots = term_snapshots_create();
+     if (!term->snapshots) {
+          DirectFBError( "Failed to create snapshots", DFB_FAILURE );
+          ret = DFB_FAILURE;
+          goto out;
+     }
+
      direct_mutex_init( &term->lock );
+     direct_mutex_init( &term->render_lock );
+     direct_mutex_init( &term->wake_lock );
+     direct_waitqueue_init( &term->render_wq );
 
      direct_mutex_lock( &term->lock );
 
-     term->update_thread = direct_thread_create( DTT_DEFAULT, term_update, term, "Term Update" );
+     term->render_thread = direct_thread_create( DTT_DEFAULT, term_render_thread, term, "Term Render" );
+
+     /* Show the initial screen */
+     term_publish( term );
+
+     if (term->replay)
+          term->update_thread = direct_thread_create( DTT_DEFAULT, term_replay, term, "Term Replay" );
+     else
+          term->update_thread = direct_thread_create( DTT_DEFAULT, term_update, term, "Term Update" );
 
      /* Show the terminal window */
      lite_set_window_opacity( term->window, liteFullWindowOpacity );
@@ -1441,6 +1800,9 @@ int main( int argc, char *argv[] )
                                    case DIKS_PAGE_DOWN:
                                         scroll += termrows - 1;
                                         break;
+                                   case DIKS_F12:
+                                        term_toggle_hud( term );
+                                        break;
                                    default:
                                         term_handle_key( term, &evt );
                                         break;
@@ -1470,8 +1832,6 @@ int main( int argc, char *argv[] )
 
           if (scroll)
                term_scroll( term, scroll );
-
-          term_flush_flip( term );
      }
 
      if (!term->update_closing)
@@ -1479,27 +1839,66 @@ int main( int argc, char *argv[] )
      direct_thread_join( term->update_thread );
      direct_thread_destroy( term->update_thread );
 
+     direct_mutex_lock( &term->wake_lock );
+
+     term->render_closing = true;
+
+     direct_waitqueue_broadcast( &term->render_wq );
+
+     direct_mutex_unlock( &term->wake_lock );
+
+     direct_thread_join( term->render_thread );
+     direct_thread_destroy( term->render_thread );
+
+     direct_waitqueue_deinit( &term->render_wq );
+     direct_mutex_deinit( &term->wake_lock );
+     direct_mutex_deinit( &term->render_lock );
      direct_mutex_deinit( &term->lock );
 
 #ifdef USE_LIBTSM
-     shl_pty_bridge_free( term->pty_bridge );
-     shl_pty_close( term->pty );
+     if (!term->replay) {
+          shl_pty_bridge_free( term->pty_bridge );
+          shl_pty_close( term->pty );
+     }
 #else
      vt_closepty( &term->vtx->vt );
 #endif
 
 out:
+#ifdef USE_LIBTSM
+     if (memory && term->screen) {
+#else
+     if (memory && term->vtx) {
+#endif
+          TermMemory usage;
+
+          term_get_memory( term, &usage );
+
+          term_memory_dump( &usage, stderr );
+     }
+
 #ifdef USE_LIBTSM
      if (term->vte)
           tsm_vte_unref( term->vte );
 
      if (term->screen)
           tsm_screen_unref( term->screen );
+
+     if (term->image)
+          term->image->Release( term->image );
 #else
      if (term->vtx)
           vtx_destroy( term->vtx );
 #endif
 
+     term_snapshots_destroy( term->snapshots );
+
+     free( term->shown );
+     free( term->shown_ids );
+
+     if (term->hud_surface)
+          term->hud_surface->Release( term->hud_surface );
+
      if (term->bar_surface)
           term->bar_surface->Release( term->bar_surface );
 
@@ -1509,6 +1908,16 @@ out:
      if (term->font)
           term->font->Release( term->font );
 
+     term_record_close( term->replay );
+     term_record_close( term->record );
+
+     if (latency && term->stats)
+          term_stats_dump( term->stats, stderr );
+
+     term_stats_destroy( term->stats );
+
+     term_clipboard_destroy( term->clipboard );
+
      D_FREE( term );
 
      lite_close();
@@ -21,6 +21,156 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#ifdef G_ALLOC_STATS
+#include <signal.h>
+#include <time.h>
+#endif
+
+#ifdef G_ALLOC_STATS
+
+#define G_ALLOC_MAX_SITES 64
+
+typedef struct {
+     const char    *tag;
+     unsigned long  calls;
+     unsigned long  frees;
+     unsigned long  total;
+     unsigned long  live;
+     unsigned long  peak;
+     long long      time;  /* nanoseconds spent in the allocator */
+} GAllocSite;
+
+/* Prepended to every block, keeps the alignment of malloc() */
+typedef union {
+     struct {
+          GAllocSite    *site;
+          unsigned long  size;
+     } info;
+     long double align;
+} GAllocHeader;
+
+static GAllocSite            alloc_sites[G_ALLOC_MAX_SITES];
+static int                   alloc_num_sites;
+static volatile int          alloc_lock;
+static volatile sig_atomic_t alloc_dump_requested;
+
+static long long
+alloc_now( void )
+{
+     struct timespec ts;
+
+     clock_gettime( CLOCK_MONOTONIC, &ts );
+
+     return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static void
+alloc_dump( void )
+{
+     int           i;
+     unsigned long live = 0;
+
+     fprintf( stderr, "Allocations by call site:\n" );
+     fprintf( stderr, "  %-24s %10s %10s %12s %10s %10s %10s\n",
+              "site", "calls", "frees", "total kB", "live kB", "peak kB", "time ms" );
+
+     for (i = 0; i < alloc_num_sites; i++) {
+          GAllocSite *site = &alloc_sites[i];
+
+          fprintf( stderr, "  %-24s %10lu %10lu %12lu %10lu %10lu %10.2f\n", site->tag, site->calls, site->frees,
+                   site->total / 1024, site->live / 1024, site->peak / 1024, site->time / 1000000.0 );
+
+          live += site->live;
+     }
+
+     fprintf( stderr, "  %lu kB live\n", live / 1024 );
+}
+
+static void
+alloc_signal_handler( int signum )
+{
+     alloc_dump_requested = 1;
+}
+
+__attribute__((constructor)) static void
+alloc_init( void )
+{
+     struct sigaction action;
+
+     memset( &action, 0, sizeof(action) );
+     action.sa_handler = alloc_signal_handler;
+     action.sa_flags   = SA_RESTART;
+     sigemptyset( &action.sa_mask );
+
+     sigaction( SIGUSR2, &action, NULL );
+
+     atexit( alloc_dump );
+}
+
+static GAllocSite *
+alloc_site( const char *tag )
+{
+     int i;
+
+     /* Tags are the __func__ of the caller, so comparing the pointers is enough */
+     for (i = 0; i < alloc_num_sites; i++) {
+          if (alloc_sites[i].tag == tag)
+               return &alloc_sites[i];
+     }
+
+     if (alloc_num_sites == G_ALLOC_MAX_SITES)
+          return &alloc_sites[G_ALLOC_MAX_SITES - 1];
+
+     alloc_sites[alloc_num_sites].tag = tag;
+
+     return &alloc_sites[alloc_num_sites++];
+}
+
+/* Called with the lock held */
+static void
+alloc_account( GAllocHeader *header, const char *tag, unsigned long size, long long start )
+{
+     GAllocSite *site = alloc_site( tag );
+
+     site->calls++;
+     site->total += size;
+     site->live  += size;
+
+     if (site->peak < site->live)
+          site->peak = site->live;
+
+     site->time += alloc_now() - start;
+
+     header->info.site = site;
+     header->info.size = size;
+
+     if (alloc_dump_requested) {
+          alloc_dump_requested = 0;
+          alloc_dump();
+     }
+}
+
+static void
+alloc_release( GAllocHeader *header )
+{
+     header->info.site->frees++;
+     header->info.site->live -= header->info.size;
+}
+
+static void
+alloc_lock_acquire( void )
+{
+     while (__sync_lock_test_and_set( &alloc_lock, 1 ))
+          ;
+}
+
+static void
+alloc_lock_release( void )
+{
+     __sync_lock_release( &alloc_lock );
+}
+
+#endif
 
 void
 g_error( const char *fmt, ... )
@@ -37,7 +187,30 @@ g_error( const char *fmt, ... )
 void
 g_free( void *mem )
 {
+#ifdef G_ALLOC_STATS
+     GAllocHeader *header;
+     GAllocSite   *site;
+     long long     start;
+
+     if (!mem)
+          return;
+
+     header = (GAllocHeader*) mem - 1;
+     site   = header->info.site;
+     start  = alloc_now();
+
+     alloc_lock_acquire();
+     alloc_release( header );
+     alloc_lock_release();
+
+     free( header );
+
+     alloc_lock_acquire();
+     site->time += alloc_now() - start;
+     alloc_lock_release();
+#else
      free( mem );
+#endif
 }
 
 char *
@@ -46,6 +219,69 @@ g_locale_to_utf8( const char *str, ... )
      return NULL;
 }
 
+#ifdef G_ALLOC_STATS
+void *
+g_malloc_tagged( unsigned long  size,
+                 const char    *tag )
+{
+     GAllocHeader *header;
+     long long     start = alloc_now();
+
+     header = malloc( sizeof(GAllocHeader) + size );
+     if (!header)
+          return NULL;
+
+     alloc_lock_acquire();
+     alloc_account( header, tag, size, start );
+     alloc_lock_release();
+
+     return header + 1;
+}
+
+void *
+g_malloc0_tagged( unsigned long  size,
+                  const char    *tag )
+{
+     GAllocHeader *header;
+     long long     start = alloc_now();
+
+     header = calloc( 1, sizeof(GAllocHeader) + size );
+     if (!header)
+          return NULL;
+
+     alloc_lock_acquire();
+     alloc_account( header, tag, size, start );
+     alloc_lock_release();
+
+     return header + 1;
+}
+
+void *
+g_realloc_tagged( void          *mem,
+                  unsigned long  size,
+                  const char    *tag )
+{
+     GAllocHeader *header = mem ? (GAllocHeader*) mem - 1 : NULL;
+     long long     start  = alloc_now();
+
+     /* The old header is copied along, on failure the block is left as is */
+     header = realloc( header, sizeof(GAllocHeader) + size );
+     if (!header)
+          return NULL;
+
+     alloc_lock_acquire();
+
+     /* The block is accounted to the call site of the last reallocation */
+     if (mem)
+          alloc_release( header );
+
+     alloc_account( header, tag, size, start );
+
+     alloc_lock_release();
+
+     return header + 1;
+}
+#else
 void *
 g_malloc( unsigned long size )
 {
@@ -64,6 +300,7 @@ g_realloc( void          *mem,
 {
      return realloc( mem, size );
 }
+#endif
 
 GSList *
 g_slist_prepend( GSList *list,
@@ -122,7 +359,8 @@ g_string_new( const char *str )
      GString *string = malloc( sizeof(GString) );
      int      len    = strlen( str );
 
-     string->str = malloc( len + 1 );
+     /* The segment may be released with g_free() */
+     string->str = g_malloc( len + 1 );
      string->len = len;
 
      strcpy( string->str, str );
@@ -144,7 +382,7 @@ g_string_free( GString  *string,
      char *segment;
 
      if (free_segment) {
-          free( string->str );
+          g_free( string->str );
           segment = NULL;
      }
      else
@@ -39,10 +39,20 @@ typedef struct
 void     g_error                ( const char *fmt, ... );
 void     g_free                 ( void *mem );
 char    *g_locale_to_utf8       ( const char *str, ... );
+#ifdef G_ALLOC_STATS
+/* Allocations are accounted per call site, reported at exit and on SIGUSR2 */
+void    *g_malloc_tagged        ( unsigned long size, const char *tag );
+void    *g_malloc0_tagged       ( unsigned long size, const char *tag );
+void    *g_realloc_tagged       ( void *mem, unsigned long size, const char *tag );
+#define  g_malloc(size)         g_malloc_tagged( size, __func__ )
+#define  g_malloc0(size)        g_malloc0_tagged( size, __func__ )
+#define  g_realloc(mem,size)    g_realloc_tagged( mem, size, __func__ )
+#else
 void    *g_malloc               ( unsigned long size );
 void    *g_malloc0              ( unsigned long size );
-#define  g_new(type, n)         ((type*) g_malloc( sizeof(type) * (n) ))
 void    *g_realloc              ( void *mem, unsigned long size );
+#endif
+#define  g_new(type, n)         ((type*) g_malloc( sizeof(type) * (n) ))
 GSList  *g_slist_prepend        ( GSList *list, void *data );
 GSList  *g_slist_remove         ( GSList *list, void *data );
 int      g_snprintf             ( char *str, unsigned long size, const char *fmt, ... );
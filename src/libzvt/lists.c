@@ -19,6 +19,10 @@
  *  Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
  */
 
+#include <string.h>
+
+#include <glib.h>
+
 #include "lists.h"
 
 #define d(x)
@@ -156,3 +160,162 @@ struct vt_listnode *vt_list_index(struct vt_list *l, int index)
     return 0;
   }
 }
+
+/* slot of node 'index', which must be 0 .. r->size-1 */
+#define RING_SLOT(r, index) \
+  ((r)->first + (index) < (r)->size ? (r)->first + (index) : (r)->first + (index) - (r)->size)
+
+void vt_ring_new(struct vt_ring *r)
+{
+  r->nodes = 0L;
+  r->size = 0;
+  r->first = 0;
+  r->count = 0;
+}
+
+/* frees the ring, the nodes are up to the caller */
+void vt_ring_free(struct vt_ring *r)
+{
+  g_free(r->nodes);
+  vt_ring_new(r);
+}
+
+/* make room for at least 'size' nodes */
+void vt_ring_reserve(struct vt_ring *r, int size)
+{
+  if (size <= r->size)
+    return;
+
+  r->nodes = g_realloc(r->nodes, size * sizeof(void *));
+
+  /* the nodes wrapped around, move the first ones to the new end */
+  if (r->first) {
+    memmove(&r->nodes[r->first + size - r->size], &r->nodes[r->first],
+	    (r->size - r->first) * sizeof(void *));
+    r->first += size - r->size;
+  }
+  r->size = size;
+}
+
+/* make room for one more node */
+static void vt_ring_grow(struct vt_ring *r)
+{
+  if (r->count < r->size)
+    return;
+
+  vt_ring_reserve(r, r->size ? r->size * 2 : 16);
+}
+
+/* add node to head of ring */
+void *vt_ring_addhead(struct vt_ring *r, void *n)
+{
+  vt_ring_grow(r);
+  r->first = r->first ? r->first - 1 : r->size - 1;
+  r->nodes[r->first] = n;
+  r->count++;
+  return n;
+}
+
+/* add node to tail of ring */
+void *vt_ring_addtail(struct vt_ring *r, void *n)
+{
+  vt_ring_grow(r);
+  r->nodes[RING_SLOT(r, r->count)] = n;
+  r->count++;
+  return n;
+}
+
+/* removes head node of ring */
+void *vt_ring_remhead(struct vt_ring *r)
+{
+  void *n;
+
+  if (r->count == 0)
+    return 0L;
+
+  n = r->nodes[r->first];
+  r->first = r->first + 1 < r->size ? r->first + 1 : 0;
+  r->count--;
+  return n;
+}
+
+/* removes tail node of ring */
+void *vt_ring_remtail(struct vt_ring *r)
+{
+  if (r->count == 0)
+    return 0L;
+
+  r->count--;
+  return r->nodes[RING_SLOT(r, r->count)];
+}
+
+/* find a node by numerical index, as vt_list_index()
+   if negative, then count from the ring tail, "node -1" is the last */
+void *vt_ring_index(struct vt_ring *r, int index)
+{
+  if (index < 0)
+    index += r->count;
+  if (index < 0 || index >= r->count)
+    return 0L;
+  return r->nodes[RING_SLOT(r, index)];
+}
+
+/* replace node 'index', returns the old one */
+void *vt_ring_set(struct vt_ring *r, int index, void *n)
+{
+  void **slot = &r->nodes[RING_SLOT(r, index)];
+  void *old = *slot;
+
+  *slot = n;
+  return old;
+}
+
+static void vt_ring_reverse(struct vt_ring *r, int start, int end)
+{
+  void **a, **b, *n;
+
+  for (end--; start < end; start++, end--) {
+    a = &r->nodes[RING_SLOT(r, start)];
+    b = &r->nodes[RING_SLOT(r, end)];
+    n = *a;
+    *a = *b;
+    *b = n;
+  }
+}
+
+/* rotate nodes start to end-1 towards the head by count, so node
+   start+count becomes node start.  a negative count rotates towards
+   the tail */
+void vt_ring_rotate(struct vt_ring *r, int start, int end, int count)
+{
+  int len = end - start;
+
+  if (len < 2)
+    return;
+
+  count %= len;
+  if (count < 0)
+    count += len;
+  if (count == 0)
+    return;
+
+  if (len == r->count) {
+    /* the whole ring, move nodes from one end to the other */
+    if (count <= len / 2) {
+      while (count--)
+	vt_ring_addtail(r, vt_ring_remhead(r));
+    } else {
+      for (count = len - count; count; count--)
+	vt_ring_addhead(r, vt_ring_remtail(r));
+    }
+  } else if (start == 0 && (r->count - end) + count < len) {
+    /* a head range with few nodes after it, rotate the whole ring
+       and then move the nodes after the range back behind it */
+    vt_ring_rotate(r, 0, r->count, count);
+    vt_ring_rotate(r, end - count, r->count, -count);
+  } else {
+    vt_ring_reverse(r, start, start + count);
+    vt_ring_reverse(r, start + count, end);
+    vt_ring_reverse(r, start, end);
+  }
+}
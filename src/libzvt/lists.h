@@ -44,4 +44,23 @@ struct vt_listnode *vt_list_remove(struct vt_listnode *n);
 struct vt_listnode *vt_list_insert(struct vt_list *l, struct vt_listnode *p, struct vt_listnode *n);
 struct vt_listnode *vt_list_index(struct vt_list *l, int index);
 
+/* circular array of nodes, for constant time access by index */
+struct vt_ring {
+  void **nodes;			/* size slots, node 0 is in slot 'first' */
+  int size;
+  int first;
+  int count;			/* nodes in the ring */
+};
+
+void vt_ring_new(struct vt_ring *r);
+void vt_ring_free(struct vt_ring *r);
+void vt_ring_reserve(struct vt_ring *r, int size);
+void *vt_ring_addhead(struct vt_ring *r, void *n);
+void *vt_ring_addtail(struct vt_ring *r, void *n);
+void *vt_ring_remhead(struct vt_ring *r);
+void *vt_ring_remtail(struct vt_ring *r);
+void *vt_ring_index(struct vt_ring *r, int index);
+void *vt_ring_set(struct vt_ring *r, int index, void *n);
+void vt_ring_rotate(struct vt_ring *r, int start, int end, int count);
+
 #endif /* _LISTS_H */
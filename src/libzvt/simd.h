@@ -0,0 +1,356 @@
+/*  simd.h - Zed's Virtual Terminal
+ *
+ *  Vectorised helpers for the parser hot paths.  AVX2 or SSE2 is used
+ *  when the compiler targets it, otherwise a word-at-a-time scalar
+ *  version.
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Library General Public License
+ *  as published by the Free Software Foundation; either version 2 of
+ *  the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Library General Public
+ *  License along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+#ifndef _ZVT_SIMD_H_
+#define _ZVT_SIMD_H_
+
+#include <stdint.h>
+#include <string.h>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define VT_SIMD_AVX2 1
+#define VT_SIMD_SSE2 1
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define VT_SIMD_SSE2 1
+#endif
+
+/*
+ * vt_simd_printable:
+ *
+ * Returns the number of leading bytes of @p (at most @n) that are
+ * printable ascii, i.e. in the range 0x20-0x7e.
+ */
+static inline int
+vt_simd_printable(const unsigned char *p, int n)
+{
+  int i = 0;
+
+#ifdef VT_SIMD_AVX2
+  {
+    /* (c - 0x20) ^ 0x80 < 0x5f ^ 0x80, as a signed comparison */
+    const __m256i bias = _mm256_set1_epi8(0x60);
+    const __m256i limit = _mm256_set1_epi8((char)0xdf);
+
+    for (; i + 32 <= n; i += 32) {
+      __m256i v = _mm256_add_epi8(_mm256_loadu_si256((const __m256i *)(p + i)), bias);
+      unsigned int mask = _mm256_movemask_epi8(_mm256_cmpgt_epi8(limit, v));
+
+      if (mask != 0xffffffffu)
+	return i + __builtin_ctz(~mask);
+    }
+  }
+#endif
+#ifdef VT_SIMD_SSE2
+  {
+    const __m128i bias = _mm_set1_epi8(0x60);
+    const __m128i limit = _mm_set1_epi8((char)0xdf);
+
+    for (; i + 16 <= n; i += 16) {
+      __m128i v = _mm_add_epi8(_mm_loadu_si128((const __m128i *)(p + i)), bias);
+      unsigned int mask = _mm_movemask_epi8(_mm_cmplt_epi8(v, limit));
+
+      if (mask != 0xffff)
+	return i + __builtin_ctz(~mask & 0xffff);
+    }
+  }
+#else
+  {
+    const uint64_t ones = 0x0101010101010101ULL;
+    const uint64_t high = 0x8080808080808080ULL;
+
+    /* a word is skipped if no byte is below 0x20 and none is 0x7f or above */
+    for (; i + 8 <= n; i += 8) {
+      uint64_t x;
+
+      memcpy(&x, p + i, 8);
+      if ((((x - ones * 0x20) | (x + ones)) | x) & high)
+	break;
+    }
+  }
+#endif
+
+  while (i < n && p[i] >= 0x20 && p[i] < 0x7f)
+    i++;
+
+  return i;
+}
+
+/*
+ * vt_simd_text:
+ *
+ * Returns the number of leading bytes of @p (at most @n) that are
+ * not control characters, i.e. neither below 0x20 nor 0x7f.  Bytes
+ * with the high bit set are accepted, they are validated by the
+ * caller.
+ */
+static inline int
+vt_simd_text(const unsigned char *p, int n)
+{
+  int i = 0;
+
+#ifdef VT_SIMD_AVX2
+  {
+    const __m256i c0 = _mm256_set1_epi8(0x1f);
+    const __m256i del = _mm256_set1_epi8(0x7f);
+
+    for (; i + 32 <= n; i += 32) {
+      __m256i v = _mm256_loadu_si256((const __m256i *)(p + i));
+      __m256i ctrl = _mm256_or_si256(_mm256_cmpeq_epi8(_mm256_min_epu8(v, c0), v),
+				     _mm256_cmpeq_epi8(v, del));
+      unsigned int mask = _mm256_movemask_epi8(ctrl);
+
+      if (mask)
+	return i + __builtin_ctz(mask);
+    }
+  }
+#endif
+#ifdef VT_SIMD_SSE2
+  {
+    const __m128i c0 = _mm_set1_epi8(0x1f);
+    const __m128i del = _mm_set1_epi8(0x7f);
+
+    for (; i + 16 <= n; i += 16) {
+      __m128i v = _mm_loadu_si128((const __m128i *)(p + i));
+      __m128i ctrl = _mm_or_si128(_mm_cmpeq_epi8(_mm_min_epu8(v, c0), v), _mm_cmpeq_epi8(v, del));
+      unsigned int mask = _mm_movemask_epi8(ctrl);
+
+      if (mask)
+	return i + __builtin_ctz(mask);
+    }
+  }
+#else
+  {
+    const uint64_t ones = 0x0101010101010101ULL;
+    const uint64_t high = 0x8080808080808080ULL;
+
+    /* a word is skipped if no byte is below 0x20 and none is 0x7f */
+    for (; i + 8 <= n; i += 8) {
+      uint64_t x, y;
+
+      memcpy(&x, p + i, 8);
+      y = x ^ (ones * 0x7f);
+      if ((((x - ones * 0x20) & ~x) | ((y - ones) & ~y)) & high)
+	break;
+    }
+  }
+#endif
+
+  while (i < n && p[i] >= 0x20 && p[i] != 0x7f)
+    i++;
+
+  return i;
+}
+
+/*
+ * vt_simd_string:
+ *
+ * Returns the number of leading bytes of @p (at most @n) that can be
+ * part of an OSC string, i.e. are neither BEL, LF nor ESC.
+ */
+static inline int
+vt_simd_string(const unsigned char *p, int n)
+{
+  int i = 0;
+
+#ifdef VT_SIMD_AVX2
+  {
+    const __m256i bel = _mm256_set1_epi8(0x07);
+    const __m256i lf = _mm256_set1_epi8(0x0a);
+    const __m256i esc = _mm256_set1_epi8(0x1b);
+
+    for (; i + 32 <= n; i += 32) {
+      __m256i v = _mm256_loadu_si256((const __m256i *)(p + i));
+      __m256i end = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(v, bel), _mm256_cmpeq_epi8(v, lf)),
+				    _mm256_cmpeq_epi8(v, esc));
+      unsigned int mask = _mm256_movemask_epi8(end);
+
+      if (mask)
+	return i + __builtin_ctz(mask);
+    }
+  }
+#endif
+#ifdef VT_SIMD_SSE2
+  {
+    const __m128i bel = _mm_set1_epi8(0x07);
+    const __m128i lf = _mm_set1_epi8(0x0a);
+    const __m128i esc = _mm_set1_epi8(0x1b);
+
+    for (; i + 16 <= n; i += 16) {
+      __m128i v = _mm_loadu_si128((const __m128i *)(p + i));
+      __m128i end = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, bel), _mm_cmpeq_epi8(v, lf)),
+				 _mm_cmpeq_epi8(v, esc));
+      unsigned int mask = _mm_movemask_epi8(end);
+
+      if (mask)
+	return i + __builtin_ctz(mask);
+    }
+  }
+#else
+  {
+    const uint64_t ones = 0x0101010101010101ULL;
+    const uint64_t high = 0x8080808080808080ULL;
+
+    /* a word is skipped if none of its bytes xor'd with BEL, LF or ESC is zero */
+    for (; i + 8 <= n; i += 8) {
+      uint64_t x, a, b, c;
+
+      memcpy(&x, p + i, 8);
+      a = x ^ (ones * 0x07);
+      b = x ^ (ones * 0x0a);
+      c = x ^ (ones * 0x1b);
+      if ((((a - ones) & ~a) | ((b - ones) & ~b) | ((c - ones) & ~c)) & high)
+	break;
+    }
+  }
+#endif
+
+  while (i < n && p[i] != 0x07 && p[i] != 0x0a && p[i] != 0x1b)
+    i++;
+
+  return i;
+}
+
+/*
+ * vt_simd_expand:
+ *
+ * Stores @n bytes from @src into the cells at @dst, with @attr
+ * or'd into every cell.
+ */
+static inline void
+vt_simd_expand(uint32_t *dst, const unsigned char *src, int n, uint32_t attr)
+{
+  int i = 0;
+
+#ifdef VT_SIMD_AVX2
+  {
+    const __m256i a = _mm256_set1_epi32(attr);
+
+    for (; i + 8 <= n; i += 8) {
+      __m256i v = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i *)(src + i)));
+      _mm256_storeu_si256((__m256i *)(dst + i), _mm256_or_si256(v, a));
+    }
+  }
+#elif defined(VT_SIMD_SSE2)
+  {
+    const __m128i a = _mm_set1_epi32(attr);
+    const __m128i zero = _mm_setzero_si128();
+
+    for (; i + 16 <= n; i += 16) {
+      __m128i v = _mm_loadu_si128((const __m128i *)(src + i));
+      __m128i lo = _mm_unpacklo_epi8(v, zero);
+      __m128i hi = _mm_unpackhi_epi8(v, zero);
+
+      _mm_storeu_si128((__m128i *)(dst + i), _mm_or_si128(_mm_unpacklo_epi16(lo, zero), a));
+      _mm_storeu_si128((__m128i *)(dst + i + 4), _mm_or_si128(_mm_unpackhi_epi16(lo, zero), a));
+      _mm_storeu_si128((__m128i *)(dst + i + 8), _mm_or_si128(_mm_unpacklo_epi16(hi, zero), a));
+      _mm_storeu_si128((__m128i *)(dst + i + 12), _mm_or_si128(_mm_unpackhi_epi16(hi, zero), a));
+    }
+  }
+#endif
+
+  for (; i < n; i++)
+    dst[i] = attr | src[i];
+}
+
+/*
+ * vt_simd_fill:
+ *
+ * Stores @value into the @n cells at @dst.
+ */
+static inline void
+vt_simd_fill(uint32_t *dst, uint32_t value, int n)
+{
+  int i = 0;
+
+#ifdef VT_SIMD_AVX2
+  {
+    const __m256i v = _mm256_set1_epi32(value);
+
+    for (; i + 8 <= n; i += 8)
+      _mm256_storeu_si256((__m256i *)(dst + i), v);
+  }
+#endif
+#ifdef VT_SIMD_SSE2
+  {
+    const __m128i v = _mm_set1_epi32(value);
+
+    for (; i + 4 <= n; i += 4)
+      _mm_storeu_si128((__m128i *)(dst + i), v);
+  }
+#else
+  {
+    const uint64_t v = value * 0x100000001ULL;
+
+    for (; i + 2 <= n; i += 2)
+      memcpy(dst + i, &v, 8);
+  }
+#endif
+
+  for (; i < n; i++)
+    dst[i] = value;
+}
+
+/*
+ * vt_simd_move:
+ *
+ * Copies @n cells from @src to @dst, the ranges may overlap.  Every
+ * block is loaded before the block at the same offset is stored, so
+ * copying towards the start runs forwards and towards the end runs
+ * backwards.
+ */
+static inline void
+vt_simd_move(uint32_t *dst, const uint32_t *src, int n)
+{
+  int i;
+
+  if (dst == src || n <= 0)
+    return;
+
+  if (dst < src) {
+    i = 0;
+#ifdef VT_SIMD_AVX2
+    for (; i + 8 <= n; i += 8)
+      _mm256_storeu_si256((__m256i *)(dst + i), _mm256_loadu_si256((const __m256i *)(src + i)));
+#elif defined(VT_SIMD_SSE2)
+    for (; i + 4 <= n; i += 4)
+      _mm_storeu_si128((__m128i *)(dst + i), _mm_loadu_si128((const __m128i *)(src + i)));
+#endif
+    for (; i < n; i++)
+      dst[i] = src[i];
+  } else {
+    i = n;
+#ifdef VT_SIMD_AVX2
+    for (; i >= 8; i -= 8)
+      _mm256_storeu_si256((__m256i *)(dst + i - 8), _mm256_loadu_si256((const __m256i *)(src + i - 8)));
+#elif defined(VT_SIMD_SSE2)
+    for (; i >= 4; i -= 4)
+      _mm_storeu_si128((__m128i *)(dst + i - 4), _mm_loadu_si128((const __m128i *)(src + i - 4)));
+#endif
+    while (i > 0) {
+      i--;
+      dst[i] = src[i];
+    }
+  }
+}
+
+#endif /* _ZVT_SIMD_H_ */
@@ -71,7 +71,6 @@ static void vt_line_update(struct _vtx *vx, struct vt_line *l, struct vt_line *b
 
   /* some sanity checks */
   g_return_if_fail (bl != NULL);
-  g_return_if_fail (bl->next != NULL);
 
   /* work out if selections are being rendered */
   if (vx->selected &&
@@ -216,6 +215,7 @@ static void vt_line_update(struct _vtx *vx, struct vt_line *l, struct vt_line *b
   }
 
   l->modcount = 0;
+  VT_LINE_CLEAN(l);
   bl->line = line;
   l->line = line;
 }
@@ -225,22 +225,34 @@ int vt_get_attr_at (struct _vtx *vx, int col, int row)
 {
   struct vt_line *line;
   
-  line = (struct vt_line *) vt_list_index (&vx->vt.lines_back, row);
+  line = (struct vt_line *) vt_ring_index (&vx->vt.lines_back, row);
   return line->data [col];
 }
 
+/* view index of the top line shown, see vt_view_line() */
+static int vt_view_top(struct _vtx *vx)
+{
+  if (vx->vt.scrollbackoffset < -vx->vt.scrollbacklines) {
+    /* check for error condition */
+    printf("LINE UNDERFLOW!\n");
+    return -vx->vt.scrollbacklines;
+  }
+  return vx->vt.scrollbackoffset;
+}
+
 /*
   scroll/update a section of lines
   from firstline (fn), scroll count lines 'offset' lines
 */
 static int vt_scroll_update(struct _vtx *vx, struct vt_line *fn, int firstline, int count, int offset, int scrolled)
 {
-  struct vt_line *tn, *bn, *dn, *nn, *bl;	/* top/bottom of scroll area */
-  int i, fill;
+  struct vt_line *tn, *nn, *bl;
+  int i, j, fill;
   int force;
   int top,bottom;
   int index;
   int end;
+  int start, stop, clear;	/* scroll area, and where the lines scrolled in go */
 
   /* if we are not scrolling, then the background doesn't need rendering! */
   if (vx->scroll_type == VT_SCROLL_SOMETIMES)
@@ -251,12 +263,10 @@ static int vt_scroll_update(struct _vtx *vx, struct vt_line *fn, int firstline,
   d(printf("scrolling %d lines from %d, by %d\n", count, firstline, offset));
 
   d({
-    struct vt_line *wn;
     printf("before:\n");
-    wn = &vx->vt.lines_back.head;
-    while(wn) {
-      printf("node %p:  n: %p  p:%p -> %d\n", wn, wn->next, wn->prev, wn->line);
-      wn = wn->next;
+    for (i=0;i<vx->vt.lines_back.count;i++) {
+      tn = (struct vt_line *)vt_ring_index(&vx->vt.lines_back, i);
+      printf("node %p -> %d\n", tn, tn->line);
     }
   });
 
@@ -267,61 +277,43 @@ static int vt_scroll_update(struct _vtx *vx, struct vt_line *fn, int firstline,
 
     /* find start/end of scroll area */
     if (offset > 0) {
-      /* grab n lines at bottom of scroll area, and move them to above it */
-      tn = (struct vt_line *)vt_list_index(&vx->vt.lines_back, firstline);
-      nn = (struct vt_line *)vt_list_index(&vx->vt.lines, firstline);
-      bn = (struct vt_line *)vt_list_index(&vx->vt.lines_back, firstline+offset-1);
-      dn = (struct vt_line *)vt_list_index(&vx->vt.lines_back, firstline+count+offset);
-    } else {
       /* grab n lines at top of scroll area, and move them to below it */
-      tn = (struct vt_line *)vt_list_index(&vx->vt.lines_back, firstline+count+offset);
-      nn = (struct vt_line *)vt_list_index(&vx->vt.lines, firstline+count+offset);
-      bn = (struct vt_line *)vt_list_index(&vx->vt.lines_back, firstline+count-1);
-      dn = (struct vt_line *)vt_list_index(&vx->vt.lines_back, firstline+offset);
+      start = firstline;
+      stop = firstline+count+offset;
+      clear = firstline+count;
+      nn = (struct vt_line *)vt_ring_index(&vx->vt.lines, firstline);
+    } else {
+      /* grab n lines at bottom of scroll area, and move them to above it */
+      start = firstline+offset;
+      stop = firstline+count;
+      clear = start;
+      nn = (struct vt_line *)vt_ring_index(&vx->vt.lines, firstline+count+offset);
     }
     
-    if (!tn || !nn || !bn || !dn) {
-      g_error("vt_scroll_update tn=%p nn=%p bn=%p dn=%p\n", tn, nn, bn, dn);
+    if (start < 0 || stop > vx->vt.lines_back.count || !nn) {
+      g_error("vt_scroll_update start=%d stop=%d nn=%p\n", start, stop, nn);
     }
 
-    /*    
-	  0->dn->4->tn->1->2->bn->5
-	  0->dn->4->5
-	  0->tn->1->2->bn->dn->4->5
-    */
-    
-    /* remove the scroll segment */
-    tn->prev->next = bn->next;
-    bn->next->prev = tn->prev;
-    
-    /* insert it again at the destination */
-    tn->prev = dn->prev;
-    dn->prev->next = tn;
-    bn->next = dn;
-    dn->prev = bn;
+    vt_ring_rotate(&vx->vt.lines_back, start, stop, offset);
     
     d({
-      struct vt_line *wn;
-      int line;
       printf("After\n");
-      wn = &vx->vt.lines_back.head;
-      line=0;
-      while(wn && line<vx->vt.height) {
-	printf("node %p:  n: %p  p:%p -> %d\n", wn, wn->next, wn->prev, wn->line);
-	wn = wn->next;
-	line++;
+      for (i=0;i<vx->vt.lines_back.count;i++) {
+	tn = (struct vt_line *)vt_ring_index(&vx->vt.lines_back, i);
+	printf("node %p -> %d\n", tn, tn->line);
       }
     });
 
     /* this 'clears' the rendered data, to properly reflect what just happened.
        SPEEDUP: I suppose we could just leave it as is if we dont have a pixmap ... */
     fill = nn->data[0] & VTATTR_MASK;
-    do {
+    for (j = clear; j < clear + (offset > 0 ? offset : -offset); j++) {
+      tn = (struct vt_line *)vt_ring_index(&vx->vt.lines_back, j);
       d(printf("clearning line %d\n", tn->line));
       for (i = 0; i < tn->width; i++) {
 	tn->data[i] = fill;
       }
-    } while ((tn!=bn) && (tn=tn->next));
+    }
     
     /* find out what colour the new lines is - make it match (use
      * first character as a guess), and perform the visual scroll 
@@ -339,18 +331,8 @@ static int vt_scroll_update(struct _vtx *vx, struct vt_line *fn, int firstline,
     /* force update of every other line */
 
     /* get the top line */
-    index = vx->vt.scrollbackoffset;
-    if (index<0) {
-      nn = (struct vt_line *)vt_list_index(&vx->vt.scrollback, index);
-      if (!nn) {
-	/* check for error condition */
-	printf("LINE UNDERFLOW!\n");
-	nn = (struct vt_line *)vx->vt.scrollback.head;
-      }
-    } else {
-      nn = (struct vt_line *)vx->vt.lines.head;
-    }
-    bl = (struct vt_line *)vx->vt.lines_back.head;
+    index = vt_view_top(vx);
+    nn = vt_view_line(&vx->vt, index);
 
     top=firstline;bottom=firstline+count-1;
     if (vx->scroll_type == VT_SCROLL_SOMETIMES)
@@ -359,8 +341,9 @@ static int vt_scroll_update(struct _vtx *vx, struct vt_line *fn, int firstline,
 	    end = (firstline+count+offset);
 
     d(printf("fixing up [force=%d] from %d-%d\n", force, top, bottom));
-    /*for (i=0;nn->next && i<vx->vt.height;i++) {*/
-    for (i=0;nn->next && i<end;i++) {
+    /*for (i=0;nn && i<vx->vt.height;i++) {*/
+    for (i=0;nn && i<end;i++) {
+      bl = (struct vt_line *)vt_ring_index(&vx->vt.lines_back, i);
       d(printf("looking at line %d [%p] ", i, nn));
       if (i<top || i>bottom) {
 	d(printf("forcing update of %d [force=%d]\n", i, force));
@@ -373,14 +356,7 @@ static int vt_scroll_update(struct _vtx *vx, struct vt_line *fn, int firstline,
       nn->line = i;
       d(printf("%p: line %d, was %d\n", nn, i, nn->line));
 
-      if (nn==(struct vt_line *)vx->vt.scrollback.tailpred) {
-	d(printf("++ skipping to real lines at line %d\n", nn->line));
-	nn = (struct vt_line *)vx->vt.lines.head;
-      } else {
-	d(printf("++ going to next line ...\n"));
-	nn = nn->next;
-      }
-      bl = bl->next;
+      nn = vt_view_next(&vx->vt, nn, index++);
     }
     scrolled=1;
   } else {
@@ -393,50 +369,36 @@ static int vt_scroll_update(struct _vtx *vx, struct vt_line *fn, int firstline,
 
     d(printf("fake scrolling ... [force=%d]\n", force));
     if (offset>0) {
-      bl = (struct vt_line *)vt_list_index(&vx->vt.lines_back, firstline);
+      /* fn is the line shown at firstline */
+      index = vt_view_top(vx) + firstline;
 
-      for (i=firstline;nn->next && i<(firstline+count+offset);i++) {
+      for (i=firstline;nn && i<(firstline+count+offset);i++) {
+	bl = (struct vt_line *)vt_ring_index(&vx->vt.lines_back, i);
 	d(printf("updating line %d\n", i));
 	vt_line_update(vx, nn, bl, i, force, 0, bl->width);
 
-	if (nn==(struct vt_line *)vx->vt.scrollback.tailpred) {
-	  d(printf("++ skipping to real lines at line %d\n", nn->line));
-	  nn = (struct vt_line *)vx->vt.lines.head;
-	} else {
-	  d(printf("++ going to next line ...\n"));
-	  nn = nn->next;
-	}
-	bl = bl->next;
+	nn = vt_view_next(&vx->vt, nn, index++);
       }
     } else {
       index = vx->vt.scrollbackoffset + offset + firstline;
 
-      if (index<0) {
-	nn = (struct vt_line *)vt_list_index(&vx->vt.scrollback, index);
-	if (!nn) {
-	  /* check for error condition */
-	  printf("LINE UNDERFLOW!\n");
-	  nn = (struct vt_line *)vx->vt.scrollback.head;
-	}
-      } else {
-	nn = (struct vt_line *)vt_list_index(&vx->vt.lines, index);
+      nn = vt_view_line(&vx->vt, index);
+      if (!nn && index<0) {
+	/* check for error condition */
+	printf("LINE UNDERFLOW!\n");
+	index = -vx->vt.scrollbacklines;
+	nn = vt_view_line(&vx->vt, index);
       }
-      bl = (struct vt_line *)vt_list_index(&vx->vt.lines_back, offset+firstline);
 
       d(printf("updating %d to %d\n", firstline+offset, firstline+count));
       
       d(printf("negative offset - ooops\n"));
-      for (i=firstline+offset;nn->next && i<firstline+count;i++) {
+      for (i=firstline+offset;nn && i<firstline+count;i++) {
+	bl = (struct vt_line *)vt_ring_index(&vx->vt.lines_back, i);
 	d(printf("updating line %d\n", i));
 	vt_line_update(vx, nn, bl, i, force, 0, bl->width);
-	if (nn==(struct vt_line *)vx->vt.scrollback.tailpred) {
-	  d(printf("++ skipping to real lines at line %d\n", nn->line));
-	  nn = (struct vt_line *)vx->vt.lines.head;
-	} else {
-	  d(printf("++ going to next line ...\n"));
-	  nn = nn->next;
-	}
-	bl = bl->next;
+
+	nn = vt_view_next(&vx->vt, nn, index++);
       }
     }
   }
@@ -458,8 +420,9 @@ void vt_update(struct _vtx *vx, int update_state)
   int line=0;
   int offset;
   int oldoffset=0;
-  struct vt_line *wn, *nn, *fn, *bl;
+  struct vt_line *wn, *tl, *fn, *bl;
   int firstline;
+  int top;			/* view index of the top line */
   int old_state;
   int update_start=-1;	/* where to start/stop update */
   int update_end=-1;
@@ -468,7 +431,6 @@ void vt_update(struct _vtx *vx, int update_state)
   d(printf("updating screen\n"));
 
   wn = NULL;
-  nn = NULL;
   fn = NULL;
 
   old_state = vx->cursor_state(vx->vt.user_data, 0);
@@ -476,33 +438,15 @@ void vt_update(struct _vtx *vx, int update_state)
   vt_match_highlight(vx, 0);
 
   /* find first line of visible screen, take into account scrollback */
-  offset = vx->vt.scrollbackoffset;
-  if (offset<0) {
-    wn = (struct vt_line *)vt_list_index(&vx->vt.scrollback, offset);
-    if (!wn) {
-      /* check for error condition */
-      printf("LINE UNDERFLOW!\n");
-      wn = (struct vt_line *)vx->vt.scrollback.head;
-    }
-  } else {
-    wn = (struct vt_line *)vx->vt.lines.head;
-  }
+  top = vt_view_top(vx);
+  tl = wn = vt_view_line(&vx->vt, top);
   
   d({
     struct vt_line *dn;
     printf("INPUT before:\n");
-    dn = &vx->vt.lines;
-    while(dn) {
-      printf("  node %p:  n: %p  p:%p -> %d\n", dn, dn->next, dn->prev, dn->line);
-      dn = dn->next;
-    }
-
-    dn = wn;
-    while(dn) {
-      printf("  node %p:  n: %p  p:%p -> %d\n", dn, dn->next, dn->prev, dn->line);
-      dn = dn->next;
-    }
-
+    for (dn = wn, line = top; dn; dn = vt_view_next(&vx->vt, dn, line++))
+      printf("  node %p -> %d\n", dn, dn->line);
+    line = 0;
   });
 
   /* updated scrollback if we can ... otherwise dont */
@@ -521,10 +465,9 @@ void vt_update(struct _vtx *vx, int update_state)
     }
     d(printf("forced updated from %d - %d\n", update_start, update_end));
     
-    nn = wn->next;
     firstline = 0;		/* this isn't really necessary (quietens compiler) */
     fn = wn;
-    while (nn && line<vx->vt.height) {
+    while (wn && line<vx->vt.height) {
       int oldline;
 
       /* enforce full update for 'scrollback' areas */
@@ -559,17 +502,10 @@ void vt_update(struct _vtx *vx, int update_state)
       }
 
       /* goto next logical line */
-      if (wn==(struct vt_line *)vx->vt.scrollback.tailpred) {
-	d(printf("skipping to real lines at line %d\n", line));
-	wn = (struct vt_line *)vx->vt.lines.head;
-      } else {
-	d(printf("going to next line ...\n"));
-	wn = nn;
-      }
+      wn = vt_view_next(&vx->vt, wn, top+line);
 
       oldoffset = offset;
       line ++;
-      nn = wn->next;
     }
     if (oldoffset != 0) {
       d(printf("scrolling (1.3)\n"));
@@ -580,18 +516,15 @@ void vt_update(struct _vtx *vx, int update_state)
     /* now scan backwards ! */
     d(printf("scanning backwards now\n"));
     
-      /* does this need checking for overflow? */
-    if (wn == (struct vt_line *)vx->vt.lines.head) {
-      wn = (struct vt_line *)vx->vt.scrollback.tailpred;
-      nn = wn->prev;
-    } else {
-      wn = wn->prev;
-      nn = wn->prev;
-    }
+    /* from the last line scanned, wn is past the screen if it is NULL */
+    if (wn)
+      wn = vt_view_prev(&vx->vt, wn, top+line);
+    else
+      wn = vt_view_line(&vx->vt, top+line-1);
 
     line = vx->vt.height;
     oldoffset = 0;
-    while (nn && line) {
+    while (wn && line) {
       int oldline;
 
       line--;
@@ -627,17 +560,10 @@ void vt_update(struct _vtx *vx, int update_state)
       }
 
       /* goto previous logical line */
-      if (wn==(struct vt_line *)vx->vt.lines.head) {
-	wn = (struct vt_line *)vx->vt.scrollback.tailpred;
-	d(printf("going to scrollback buffer line ...\n"));
-      } else {
-	d(printf("going to prev line ...\n"));
-	wn = nn;
-      }
+      wn = vt_view_prev(&vx->vt, wn, top+line);
 
-      nn = wn->prev;
       oldoffset = offset;
-      d(printf("nn = %p\n", nn));
+      d(printf("wn = %p\n", wn));
     }
     if (oldoffset != 0) {
       d(printf("scrolling (2.3)\n"));
@@ -646,13 +572,7 @@ void vt_update(struct _vtx *vx, int update_state)
     }
 
     /* have to align the pointer properly for the last pass */
-    if (wn==(struct vt_line *)vx->vt.scrollback.tailpred) {
-      d(printf("++ skipping to real lines at line %d\n", line));
-      wn = (struct vt_line *)vx->vt.lines.head;
-    } else {
-      d(printf("++ going to next line ...\n"));
-      wn = wn->next;
-    }
+    wn = tl;
   }
 
   /* now, re-scan, since all lines should be at the right position now,
@@ -665,35 +585,30 @@ void vt_update(struct _vtx *vx, int update_state)
   else
     force = 0;
 
-  nn = wn->next;
   firstline = 0;		/* this isn't really necessary */
   fn = wn;
   line=0;
-  bl = (struct vt_line *)vx->vt.lines_back.head;
   offset = vx->vt.scrollbackoffset;
-  while (nn && line<vx->vt.height) {
+  while (wn && line<vx->vt.height) {
+    bl = (struct vt_line *)vt_ring_index(&vx->vt.lines_back, line);
     d(printf("%p: scanning line %d, was %d\n", wn, line, wn->line));
     if (wn->line==-1) {
       vt_line_update(vx, wn, bl, line, 0, 0, bl->width);
       d(printf("manual: updating line %d\n", line));
     } else if (wn->modcount || update_state) {
-      vt_line_update(vx, wn, bl, line, force, 0, bl->width);
+      /* unless forced, only the modified columns need to be compared */
+      if (force || update_state || wn->dirtystart >= wn->dirtyend)
+	vt_line_update(vx, wn, bl, line, force, 0, bl->width);
+      else
+	vt_line_update(vx, wn, bl, line, 0, wn->dirtystart, wn->dirtyend);
       d(printf("manual, forced: updating line %d\n", line));
     }
     wn->line = line;		/* make sure line is reset */
-    line++;
 
     /* goto next logical line */
-    if (wn==(struct vt_line *)vx->vt.scrollback.tailpred) {
-      d(printf("skipping to real lines at line %d\n", line));
-      wn = (struct vt_line *)vx->vt.lines.head;
-    } else {
-      wn = nn;
-    }
-    
-    nn = wn->next;
-    bl = bl->next;
-    d(printf("  -- wn = %p, wn->next = %p\n", wn, wn->next));
+    wn = vt_view_next(&vx->vt, wn, top+line);
+    line++;
+    d(printf("  -- wn = %p\n", wn));
   }
 
   vx->vt.scrollbackold = vx->vt.scrollbackoffset;
@@ -701,20 +616,17 @@ void vt_update(struct _vtx *vx, int update_state)
   /* some debug */
 #if 0
   {
-    struct vt_line *wb, *nb;
-    int i;
+    struct vt_line *wb;
+    int i, j;
 
-    wb = (struct vt_line *)vx->vt.lines_back.head;
-    nb = wb->next;
     printf("on-screen buffer contains:\n");
-    while (nb) {
+    for (j=0;j<vx->vt.lines_back.count;j++) {
+      wb = (struct vt_line *)vt_ring_index(&vx->vt.lines_back, j);
       printf("%d: ", wb->line);
       for (i=0;i<wb->width;i++) {
 	(printf("%c", (wb->data[i]&VTATTR_DATAMASK))); /*>=32?(wb->data[i]&0xffff):' '));*/
       }
       (printf("\n"));
-      wb=nb;
-      nb=nb->next;
     }
   }
 #endif
@@ -732,9 +644,9 @@ void vt_update(struct _vtx *vx, int update_state)
 */
 void vt_update_rect(struct _vtx *vx, int fill, int csx, int csy, int cex, int cey)
 {
-  struct vt_line *wn, *nn;
+  struct vt_line *wn;
   int old_state;
-  int i;
+  int i, index;
   struct vt_line *bl;
   uint32 fillin;
 
@@ -754,19 +666,15 @@ void vt_update_rect(struct _vtx *vx, int fill, int csx, int csy, int cex, int ce
     csy = vx->vt.height-1;
 
   /* check scrollback for current line */
-  if ((vx->vt.scrollbackoffset+csy)<0) {
-    wn = (struct vt_line *)vt_list_index(&vx->vt.scrollback, vx->vt.scrollbackoffset+csy);
-  } else {
-    wn = (struct vt_line *)vt_list_index(&vx->vt.lines, vx->vt.scrollbackoffset+csy);
-  }
+  index = vx->vt.scrollbackoffset+csy;
+  wn = vt_view_line(&vx->vt, index);
 
-  bl = (struct vt_line *)vt_list_index(&vx->vt.lines_back, csy);
   fillin = (fill<<VTATTR_BACKCOLOURB)&VTATTR_BACKCOLOURM;
 
   if (wn) {
-    nn = wn->next;
-    while ((csy<=cey) && nn) {
+    while ((csy<=cey) && wn) {
       d(printf("updating line %d\n", csy));
+      bl = (struct vt_line *)vt_ring_index(&vx->vt.lines_back, csy);
 
       /* make the back buffer match the screen state */
       for (i=csx;i<cex && i<bl->width;i++) {
@@ -777,14 +685,7 @@ void vt_update_rect(struct _vtx *vx, int fill, int csx, int csy, int cex, int ce
       csy++;
 
       /* skip out of scrollback buffer if need be */
-      if (wn==(struct vt_line *)vx->vt.scrollback.tailpred) {
-	wn = (struct vt_line *)vx->vt.lines.head;
-      } else {
-	wn = nn;
-      }
-
-      nn = wn->next;
-      bl = bl->next;
+      wn = vt_view_next(&vx->vt, wn, index++);
     }
   }
 
@@ -887,8 +788,8 @@ void vt_fix_selection(struct _vtx *vx)
   d(printf("fixing selection, starting at (%d,%d) (%d,%d)\n", sx, sy, ex, ey));
 
   /* check if it is 'on screen' or in the scroll back memory */
-  s = (struct vt_line *)vt_list_index(sy<0?(&vx->vt.scrollback):(&vx->vt.lines), sy);
-  e = (struct vt_line *)vt_list_index(ey<0?(&vx->vt.scrollback):(&vx->vt.lines), ey);
+  s = vt_view_line(&vx->vt, sy);
+  e = vt_view_line(&vx->vt, ey);
 
   /* if we didn't find it ... umm? FIXME: do something? */
   switch(vx->selectiontype & VT_SELTYPE_MASK) {
@@ -1092,7 +993,7 @@ static char *vt_expand_line(struct vt_line *l, int size, int start, int end, cha
 static char *
 vt_select_block(struct _vtx *vx, int size, int sx, int sy, int ex, int ey, int *len)
 {
-  struct vt_line *wn, *nn;
+  struct vt_line *wn;
   int line;
   char *out, *data;
   int tmp;
@@ -1114,11 +1015,9 @@ vt_select_block(struct _vtx *vx, int size, int sx, int sy, int ex, int ey, int *
   out = data;
 
   line = sy;
-  wn = (struct vt_line *)vt_list_index((line<0)?(&vx->vt.scrollback):(&vx->vt.lines), line);
+  wn = vt_view_line(&vx->vt, line);
 
-  if (wn)
-    nn = wn->next;
-  else {
+  if (!wn) {
     *len = 0;
     strcpy(data, "");
     return data;
@@ -1131,25 +1030,20 @@ vt_select_block(struct _vtx *vx, int size, int sx, int sy, int ex, int ey, int *
     out = vt_expand_line(wn, size, sx, ex, out);
   } else {
     /* scan lines */
-    while (nn && (line<ey)) {
+    while (wn && (line<ey)) {
       d(printf("adding selection from line %d\n", line));
       if (line == sy) {
 	out = vt_expand_line(wn, size, sx, wn->width, out); /* first line */
       } else {
 	out = vt_expand_line(wn, size, 0, wn->width, out);
       }
+      /* wraps into 'on screen' area after the scrollback */
+      wn = vt_view_next(&vx->vt, wn, line);
       line++;
-      if (line==0) {		/* wrapped into 'on screen' area? */
-	wn = (struct vt_line *)vt_list_index(&vx->vt.lines, 0);
-	nn = wn->next;
-      } else {
-	wn = nn;
-	nn = nn->next;
-      }
     }
 
     /* last line (if it exists - shouldn't happen?) */
-    if (nn)
+    if (wn)
       out = vt_expand_line(wn, size, 0, ex, out);
   }
 
@@ -1210,32 +1104,17 @@ static void vt_draw_selection_part(struct _vtx *vx, int sx, int sy, int ex, int
   d(printf("selecting from (%d,%d) to (%d,%d)\n", sx, sy, ex, ey));
 
   line = sy;
-  if (line<0) {
-    l = (struct vt_line *)vt_list_index(&vx->vt.scrollback, line);
-  } else {
-    l = (struct vt_line *)vt_list_index(&vx->vt.lines, line);
-  }
-
-  if ((line-vx->vt.scrollbackoffset)>=0)
-    bl = (struct vt_line *)vt_list_index(&vx->vt.lines_back, line-vx->vt.scrollbackoffset);
-  else
-    bl = (struct vt_line *)vx->vt.lines_back.head;
+  l = vt_view_line(&vx->vt, line);
 
   d(printf("selecting from (%d,%d) to (%d,%d)\n", sx, sy-vx->vt.scrollbackoffset, ex, ey-vx->vt.scrollbackoffset));
-  while ((line<=ey) && (l->next) && ((line-vx->vt.scrollbackoffset)<vx->vt.height)) {
-    d(printf("line %d = %p ->next = %p\n", line, l, l->next));
+  while ((line<=ey) && l && ((line-vx->vt.scrollbackoffset)<vx->vt.height)) {
+    d(printf("line %d = %p\n", line, l));
     if ((line-vx->vt.scrollbackoffset)>=0) {
+      bl = (struct vt_line *)vt_ring_index(&vx->vt.lines_back, line-vx->vt.scrollbackoffset);
       vt_line_update(vx, l, bl, line-vx->vt.scrollbackoffset, 0, 0, bl->width);
-      bl=bl->next;
-      if (bl->next==0)
-	return;
     }
+    l = vt_view_next(&vx->vt, l, line);
     line++;
-    if (line==0) {
-      l = (struct vt_line *)vt_list_index(&vx->vt.lines, 0);
-    } else {
-      l=l->next;
-    }
   }
 }
 
@@ -1313,9 +1192,9 @@ dummy_selection_changed (void *user_data)
 {
 }
 
-static struct vt_line *copy_line(struct vt_line *l)
+static struct vt_line *copy_line(struct _vtx *vx, struct vt_line *l)
 {
-  struct vt_line *n = g_malloc(VT_LINE_SIZE(l->width));
+  struct vt_line *n = vt_line_alloc(&vx->vt, l->width);
   memcpy(n, l, VT_LINE_SIZE(l->width));
   return n;
 }
@@ -1337,7 +1216,7 @@ static void vt_highlight(struct _vtx *vx, struct vt_match *m)
 	l->data[i] ^= mask;
       }
     } else {
-      b->saveline = copy_line(l);
+      b->saveline = copy_line(vx, l);
       for (i=b->start; i<b->end; i++) {
 	l->data[i] = (l->data[i] & VTATTR_DATAMASK) | mask;
       }
@@ -1368,7 +1247,7 @@ static void vt_unhighlight(struct _vtx *vx, struct vt_match *m)
       }
     } else {
       memcpy(l->data, b->saveline->data, l->width * sizeof(l->data[0]));
-      g_free(b->saveline);
+      vt_line_free(&vx->vt, b->saveline);
       b->saveline = 0;
     }
     d(printf("\n"));
@@ -1412,7 +1291,7 @@ void vt_free_match_blocks(struct _vtx *vx)
     while (b) {
       n = b->next;
       if (b->saveline)
-	g_free(b->saveline);
+	vt_line_free(&vx->vt, b->saveline);
       g_free(b);
       b=n;
     }
@@ -1431,8 +1310,9 @@ void vt_getmatches(struct _vtx *vx)
 {
   char *line, *out, *outend;
   uint32 *in, *inend;
-  struct vt_line *wn, *nn, *sol, *ssol;
+  struct vt_line *wn, *sol, *ssol;
   int lineno=0, lineskip=0, solineno;
+  int top;
   int c;
   int matchoffset;		/* for lines which span multiple lines */
   struct vt_magic_match *mw, *mn;
@@ -1445,21 +1325,12 @@ void vt_getmatches(struct _vtx *vx)
   out = line;
 
   /* start from the top */
-  if (vx->vt.scrollbackoffset<0) {
-    wn = (struct vt_line *)vt_list_index(&vx->vt.scrollback, vx->vt.scrollbackoffset);
-    if (!wn) {
-      /* check for error condition */
-      printf("LINE UNDERFLOW!\n");
-      wn = (struct vt_line *)vx->vt.scrollback.head;
-    }
-  } else {
-    wn = (struct vt_line *)vx->vt.lines.head;
-  }
+  top = vt_view_top(vx);
+  wn = vt_view_line(&vx->vt, top);
 
-  nn = wn->next;
   ssol = wn;
   matchoffset = 0;
-  while (nn && (lineno+lineskip)<vx->vt.height) {
+  while (wn && (lineno+lineskip)<vx->vt.height) {
 
     if (ssol==0)
       ssol = wn;
@@ -1517,10 +1388,7 @@ void vt_getmatches(struct _vtx *vx)
 	  while ((start-matchoffset)>sol->width) {
 	    matchoffset += sol->width;
 
-	    if (sol==(struct vt_line *)vx->vt.scrollback.tailpred)
-	      sol = (struct vt_line *)vx->vt.lines.head;
-	    else
-	      sol = sol->next;
+	    sol = vt_view_next(&vx->vt, sol, top+solineno);
 
 	    solineno++;
 	  }
@@ -1550,11 +1418,8 @@ void vt_getmatches(struct _vtx *vx)
 	  while ((end-matchoffset) > sol->width) {
 	    matchoffset += sol->width;
 
-	    if (sol==(struct vt_line *)vx->vt.scrollback.tailpred)
-	      sol = (struct vt_line *)vx->vt.lines.head;
-	    else
-		/* to fix the crash */
-	      sol = sol->next?sol->next:NULL;;
+	    /* to fix the crash */
+	    sol = vt_view_next(&vx->vt, sol, top+solineno);
 
 	    if(!sol) return;
 
@@ -1595,12 +1460,8 @@ void vt_getmatches(struct _vtx *vx)
       lineskip++;
     }
 
-    /* next logical line */
-    if (wn==(struct vt_line *)vx->vt.scrollback.tailpred)
-      wn = (struct vt_line *)vx->vt.lines.head;
-    else
-      wn = nn;
-    nn = wn->next;
+    /* next logical line, the line counts already moved past wn */
+    wn = vt_view_next(&vx->vt, wn, top+lineno+lineskip-1);
   }
 
   g_free(line);
@@ -1691,11 +1552,12 @@ struct _vtx *vtx_new(int width, int height, void *user_data)
 void vtx_destroy(struct _vtx *vx)
 {
   if (vx) {
+    /* the matches point into the lines, let go of them first */
+    vt_free_match_blocks(vx);
+    vt_match_clear(vx, 0);
     vt_destroy(&vx->vt);
     if (vx->selection_data)
       g_free(vx->selection_data);
-    vt_free_match_blocks(vx);
-    vt_match_clear(vx, 0);
     g_free(vx);
   }
 }
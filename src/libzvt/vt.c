@@ -39,6 +39,9 @@
 
 #include "lists.h"
 #include "vt.h"
+#include "simd.h"
+#include "vtparse.h"
+#include <vtdfa.h>
 #include "subshell.h"
 
 /* define to 'x' to enable copius debug of this module */
@@ -47,7 +50,7 @@
 /* this one will check nodes aren't 'past' the end of list */
 #define n(x)
 /*
-#define n(x) { if ((x)->next == 0) printf("Bad node, points beyond list: " #x "in %s: line %d\n", __PRETTY_FUNCTION__, __LINE__); }
+#define n(x) { if ((x) == 0) printf("Bad node, points beyond list: " #x "in %s: line %d\n", __PRETTY_FUNCTION__, __LINE__); }
 */
 
 /* draw selected text (if selected!) */
@@ -64,7 +67,7 @@ void vt_delete_lines(struct vt_em *vt, int count);
 void vt_clear_lines(struct vt_em *vt, int top, int count);
 void vt_clear_line_portion(struct vt_em *vt, int start_col, int end_col);
 
-static void vt_resize_lines(struct vt_line *wm, int width, uint32 default_attr);
+static void vt_resize_lines(struct vt_em *vt, struct vt_ring *ring, int width, uint32 default_attr);
 static void vt_gotoxy(struct vt_em *vt, int x, int y);
 
 static unsigned char vt_remap_dec[256];
@@ -73,36 +76,32 @@ static unsigned char vt_remap_dec[256];
 static void
 dump_scrollback(struct vt_em *vt)
 {
-  struct vt_line *wn, *nn;
+  struct vt_line *wn;
+  int i;
 
-  printf("****** scrollback list:\n");
+  printf("****** scrollback ring:\n");
   
-  wn=&vt->scrollback.head;
-  wn=&vt->lines.head;
-  while (wn) {
-    printf(" %p: p<: %p, n>:%p\n", wn, wn->prev, wn->next);
-    wn = wn->next;
+  for (i=0;i<vt->scrollback.count;i++) {
+    wn = (struct vt_line *)vt_ring_index(&vt->scrollback, i);
+    printf(" %d: %p, width %d\n", i, wn, wn->width);
   }
 }
 
 static void
 vt_dump(struct vt_em *vt)
 {
-  struct vt_line *wn, *nn;
-  int i;
+  struct vt_line *wn;
+  int i, line;
 
-  wn = (struct vt_line *)vt->lines.head;
-  nn = wn->next;
   (printf("dumping state of vt buffer:\n"));
-  while (nn) {
+  for (line=0;line<vt->lines.count;line++) {
+    wn = (struct vt_line *)vt_ring_index(&vt->lines, line);
     /*for (i=0;i<wn->width;i++) {*/
     printf ("%05d: ", wn->line);
     for (i=0;i<80;i++) {
       (printf("%c", wn->data[i]&VTATTR_DATAMASK));
     }
     (printf("\n"));
-    wn=nn;
-    nn = nn->next;
   }
   (printf("done\n"));
 }
@@ -121,7 +120,8 @@ vt_dump(struct vt_em *vt)
 
 static void vt_set_screen(struct vt_em *vt, int screen)
 {
-  struct vt_line *lh, *lt, *ah, *at;
+  struct vt_ring lh;
+  struct vt_line *wn;
   int line;
 
   d(printf("vt_set_screen(%d) called\n", screen));
@@ -130,49 +130,20 @@ static void vt_set_screen(struct vt_em *vt, int screen)
 
     d(printf("vt_set_screen swapping buffers ... from %d\n", (vt->mode&VTMODE_ALTSCREEN)?1:0));
 
-    /* need to swap 2 list headers.
-       tricky bit is catering for all the back pointers? */
-    lh = (struct vt_line *)vt->lines.head;
-    lt = (struct vt_line *)vt->lines.tailpred;
-
-    ah = (struct vt_line *)vt->lines_alt.head;
-    at = (struct vt_line *)vt->lines_alt.tailpred;    
-
-    /* set new head/tail pointers */
-    vt->lines.head = (struct vt_listnode *)ah;
-    vt->lines.tailpred = (struct vt_listnode *)at;
-
-    vt->lines_alt.head = (struct vt_listnode *)lh;
-    vt->lines_alt.tailpred = (struct vt_listnode *)lt;
-
-    /* and link back links */
-    ah->prev = (struct vt_line *)&vt->lines.head;
-    at->next = (struct vt_line *)&vt->lines.tail;
-
-    lh->prev = (struct vt_line *)&vt->lines_alt.head;
-    lt->next = (struct vt_line *)&vt->lines_alt.tail;
+    /* need to swap 2 ring headers */
+    lh = vt->lines;
+    vt->lines = vt->lines_alt;
+    vt->lines_alt = lh;
 
     /* and mark all lines as changed/but un-moved */
-    at = ah->next;
-    line=0;
-    while (at) {
-      ah->modcount=ah->width;
-      ah->line = line++;
-      ah = at;
-      at = at->next;
+    for (line=0;line<vt->lines.count;line++) {
+      wn = (struct vt_line *)vt_ring_index(&vt->lines, line);
+      wn->modcount=wn->width;
+      VT_LINE_DIRTY(wn, 0, wn->width);
+      wn->line = line;
     }
 
-    d({
-      ah = &vt->lines.head;
-      lh = &vt->lines_alt.head;
-      while (ah) {
-	printf("%p: %p %p   %p: %p %p\n", ah, ah->next, ah->prev, lh, lh->next, lh->prev);
-	ah = ah->next;
-	lh = lh->next;
-      }
-    });
-
-    vt->this_line = (struct vt_line *)vt_list_index(&vt->lines, vt->cursory);
+    vt->this_line = (struct vt_line *)vt_ring_index(&vt->lines, vt->cursory);
     n(vt->this_line);
     if (screen)
       vt->mode |= VTMODE_ALTSCREEN;
@@ -195,45 +166,281 @@ vt_scrollback_set(struct vt_em *vt, int lines)
 {
   struct vt_line *ln;
 
-  while (vt->scrollbacklines > lines) {
-    /* remove the top of list line */
-    ln = (struct vt_line *)vt_list_remhead(&vt->scrollback);
-    g_free(ln);
-    vt->scrollbacklines--;
+  if (vt->scrollbacklines > lines) {
+    while (vt->scrollbacklines > lines) {
+      /* remove the top of list line */
+      ln = (struct vt_line *)vt_ring_remhead(&vt->scrollback);
+      vt_line_free(vt, ln);
+      vt->scrollbacklines--;
+    }
+
+    /* and give the memory back */
+    vt_line_trim(vt);
   }
   vt->scrollbackmax = lines;
+
+  /* room for all of it up front, adding a line never reallocates then */
+  vt_ring_reserve(&vt->scrollback, lines);
 }
 
 /*
- * clone the line 'line' and add it to the bottom of
- * the scrollback buffer.
+ * packed scrollback lines.  lines move into the scrollback as they
+ * are, vt_scrollback_pack() packs them later on if that makes them
+ * smaller, and they are unpacked again when they are looked at
+ * through vt_view_line().
+ *
+ * the data words of a packed line are:
+ *   0: the width of the line, and VT_PACK_8BIT if the characters fit
+ *      in 8 bits
+ *   1: the cell the line ends with, repeated after the 'used' cells
+ *   2: the number of 'used' cells, and the number of runs << 16
+ *   then a word per run of cells with the same attributes, the
+ *   attributes and the length of the run
+ *   then the characters of the used cells, 4 or 2 to a word
+ */
+#define VT_PACK_8BIT 0x10000
+#define VT_PACK_HEADER 3
+#define VT_PACK_ROUND 8		/* packed sizes are multiples of this many words */
+
+static struct vt_line *
+vt_line_pack(struct vt_em *vt, struct vt_line *l)
+{
+  struct vt_line *pk;
+  uint32 *runs, *chars, *end;
+  uint32 fill, attr, high, word;
+  int used, nruns, eight, size, i, j;
+
+  if (l->width <= 0 || l->width > VTATTR_DATAMASK)
+    return NULL;
+
+  /* trailing cells the same as the last one are not stored */
+  fill = l->data[l->width-1];
+  for (used=l->width;used>0 && l->data[used-1]==fill;used--)
+    ;
+
+  /* count the runs, and see if the characters fit in 8 bits */
+  nruns = used > 0;
+  high = used > 0 ? l->data[0] : 0;
+  for (i=1;i<used;i++) {
+    nruns += ((l->data[i] ^ l->data[i-1]) & VTATTR_MASK) != 0;
+    high |= l->data[i];
+  }
+  eight = (high & VTATTR_DATAMASK) <= 0xff;
+
+  size = VT_PACK_HEADER + nruns + (eight ? (used+3)/4 : (used+1)/2);
+  size = (size + VT_PACK_ROUND-1) & ~(VT_PACK_ROUND-1);
+  if (size >= l->width)
+    return NULL;
+
+  pk = vt_line_alloc(vt, size);
+  pk->line = VT_LINE_PACKED;
+  pk->modcount = 0;
+  VT_LINE_CLEAN(pk);
+
+  pk->data[0] = l->width | (eight ? VT_PACK_8BIT : 0);
+  pk->data[1] = fill;
+  pk->data[2] = used | (nruns << 16);
+
+  runs = pk->data + VT_PACK_HEADER;
+  for (i=0;i<used;i=j) {
+    attr = l->data[i] & VTATTR_MASK;
+    for (j=i+1;j<used && (l->data[j] & VTATTR_MASK) == attr;j++)
+      ;
+    *runs++ = attr | (j - i);
+  }
+
+  chars = runs;
+  if (eight) {
+    for (i=0;i<used;i+=4) {
+      for (word=0,j=0;j<4 && i+j<used;j++)
+	word |= (l->data[i+j] & 0xff) << (j*8);
+      *chars++ = word;
+    }
+  } else {
+    for (i=0;i<used;i+=2) {
+      for (word=0,j=0;j<2 && i+j<used;j++)
+	word |= (l->data[i+j] & VTATTR_DATAMASK) << (j*16);
+      *chars++ = word;
+    }
+  }
+
+  /* the rest of the rounded size */
+  for (end=pk->data+size;chars<end;chars++)
+    *chars = 0;
+
+  return pk;
+}
+
+static struct vt_line *
+vt_line_unpack(struct vt_em *vt, struct vt_line *pk)
+{
+  struct vt_line *l;
+  uint32 *runs, *chars;
+  uint32 attr;
+  int width, used, nruns, eight, len, i, j;
+
+  width = pk->data[0] & VTATTR_DATAMASK;
+  eight = pk->data[0] & VT_PACK_8BIT;
+  used = pk->data[2] & VTATTR_DATAMASK;
+  nruns = pk->data[2] >> 16;
+
+  runs = pk->data + VT_PACK_HEADER;
+  chars = runs + nruns;
+
+  l = vt_line_alloc(vt, width);
+  for (i=0,j=0;j<nruns;j++) {
+    attr = runs[j] & VTATTR_MASK;
+    for (len=runs[j] & VTATTR_DATAMASK;len>0;len--,i++) {
+      if (eight)
+	l->data[i] = attr | ((chars[i>>2] >> ((i&3)*8)) & 0xff);
+      else
+	l->data[i] = attr | ((chars[i>>1] >> ((i&1)*16)) & VTATTR_DATAMASK);
+    }
+  }
+  vt_simd_fill(l->data + used, pk->data[1], width - used);
+
+  l->line = -1;
+  l->modcount = 0;
+  VT_LINE_CLEAN(l);
+
+  vt_line_free(vt, pk);
+
+  return l;
+}
+
+/**
+ * vt_scrollback_pack:
+ * @vt: An initialised &vt_em.
+ *
+ * Packs the lines added to the scrollback buffer since the last call,
+ * and those unpacked to be looked at.  Lines scroll out as they are,
+ * so that the parsing does not pay for this; it is meant to be called
+ * between batches of input, once per frame drawn.  Lines scrolled out
+ * and discarded in between are never packed.  Nothing is packed while
+ * the view is scrolled back.
+ */
+void
+vt_scrollback_pack(struct vt_em *vt)
+{
+  struct vt_line *wn, *pk;
+  int i;
+
+  if (vt->scrollbackoffset)
+    return;
+
+  /* lines unpacked by the view can be anywhere, new ones are at the end */
+  if (vt->scrollbackunpacked || vt->scrollbackadded > vt->scrollback.count)
+    i = 0;
+  else
+    i = vt->scrollback.count - vt->scrollbackadded;
+
+  for (;i<vt->scrollback.count;i++) {
+    wn = (struct vt_line *)vt_ring_index(&vt->scrollback, i);
+    if (wn->line != VT_LINE_PACKED && (pk = vt_line_pack(vt, wn))) {
+      vt_ring_set(&vt->scrollback, i, pk);
+      vt_line_free(vt, wn);
+    }
+  }
+  vt->scrollbackunpacked = 0;
+  vt->scrollbackadded = 0;
+}
+
+/**
+ * vt_view_line:
+ * @vt: An initialised &vt_em.
+ * @index: View index of the line.
  *
- * if the scrollback buffer is full, discard the oldest line
+ * Finds line @index of the screen, or of the scrollback buffer if
+ * @index is negative, -1 being the most recent scrollback line.
+ * Packed scrollback lines are unpacked first.
  *
- * it is up-to the caller to free or 'discard' the old line
+ * Return value: The line, or NULL if there is no such line.
  */
-static void
+struct vt_line *
+vt_view_line(struct vt_em *vt, int index)
+{
+  struct vt_line *l;
+
+  if (index < 0) {
+    if (index < -vt->scrollbacklines)
+      return NULL;
+    index += vt->scrollback.count;
+    l = (struct vt_line *)vt_ring_index(&vt->scrollback, index);
+
+    /* it stays unpacked until vt_scrollback_pack() */
+    if (l->line == VT_LINE_PACKED) {
+      l = vt_line_unpack(vt, l);
+      vt_ring_set(&vt->scrollback, index, l);
+      vt->scrollbackunpacked++;
+    }
+    return l;
+  }
+  return (struct vt_line *)vt_ring_index(&vt->lines, index);
+}
+
+/**
+ * vt_view_next:
+ * @vt: An initialised &vt_em.
+ * @l: A line, as returned by vt_view_line().
+ * @index: View index of @l.
+ *
+ * Steps from a line to the one below it, from the end of the
+ * scrollback buffer onto the screen.
+ *
+ * Return value: The line at @index+1, or NULL past the screen.
+ */
+struct vt_line *
+vt_view_next(struct vt_em *vt, struct vt_line *l, int index)
+{
+  return vt_view_line(vt, index+1);
+}
+
+/**
+ * vt_view_prev:
+ * @vt: An initialised &vt_em.
+ * @l: A line, as returned by vt_view_line().
+ * @index: View index of @l.
+ *
+ * Steps from a line to the one above it, from the top of the screen
+ * into the scrollback buffer.
+ *
+ * Return value: The line at @index-1, or NULL past the scrollback.
+ */
+struct vt_line *
+vt_view_prev(struct vt_em *vt, struct vt_line *l, int index)
+{
+  return vt_view_line(vt, index-1);
+}
+
+/*
+ * move the line 'wn' itself to the bottom of the scrollback buffer,
+ * it is packed later by vt_scrollback_pack().
+ *
+ * if the scrollback buffer is full, the oldest line is removed and
+ * returned, it is up-to the caller to reuse or free it.  if there is
+ * no scrollback buffer, 'wn' is not taken and is returned instead.
+ */
+static struct vt_line *
 vt_scrollback_add(struct vt_em *vt, struct vt_line *wn)
 {
-  struct vt_line *ln;
+  struct vt_line *ln = NULL;
+
+  /* no scrollback, the line would be discarded straight away */
+  if (vt->scrollbackmax <= 0)
+    return wn;
+
+  /* make it a scroll-back line */
+  wn->modcount = 0;
+  VT_LINE_CLEAN(wn);
+  wn->line = -1;
+  if (vt->scrollbackadded < vt->scrollbackmax)
+    vt->scrollbackadded++;
 
-  /* create a new scroll-back line */
-  ln = g_malloc(VT_LINE_SIZE(wn->width));
-  ln->next = NULL;
-  ln->prev = NULL;
-  ln->width = wn->width;
-  ln->modcount = 0;
-  memcpy(ln->data, wn->data, wn->width * sizeof(uint32));
-
-  /* add it to the scrollback buffer */
-  vt_list_addtail(&vt->scrollback, (struct vt_listnode *)ln);
-  ln->line = -1;
-  
   /* limit the total number of lines in scrollback */
   if (vt->scrollbacklines >= vt->scrollbackmax) {
-    /* remove the top of list line */
-    ln = (struct vt_line *)vt_list_remhead(&vt->scrollback);
-    g_free(ln);
+    /* remove the top of list line, the new one takes its slot */
+    ln = (struct vt_line *)vt_ring_remhead(&vt->scrollback);
+    vt_ring_addtail(&vt->scrollback, wn);
     
     /* need to track changes to this, even if they're not 'real' */
     if (vt->scrollbackoffset) {
@@ -242,6 +449,8 @@ vt_scrollback_add(struct vt_em *vt, struct vt_line *wn)
 	vt->scrollbackoffset--;
     }
   } else {
+    /* add it to the scrollback buffer */
+    vt_ring_addtail(&vt->scrollback, wn);
     vt->scrollbacklines++;
     
     /* we've effectively moved the 'old' scrollback position */
@@ -250,9 +459,80 @@ vt_scrollback_add(struct vt_em *vt, struct vt_line *wn)
       vt->scrollbackoffset--;
     }
   }
+
+  return ln;
+}
+
+/*
+ * move the line at screen row 'row' to the scrollback buffer, and put
+ * the line evicted from there in its place, or a new one if there is
+ * none of the right width.  the line returned keeps the row's line
+ * number and modified columns, but its contents are left to the caller.
+ */
+static struct vt_line *
+vt_scrollback_take(struct vt_em *vt, int row)
+{
+  struct vt_line *wn, *ln;
+  int line, modcount, dirtystart, dirtyend;
+
+  wn = (struct vt_line *)vt_ring_index(&vt->lines, row);
+  line = wn->line;
+  modcount = wn->modcount;
+  dirtystart = wn->dirtystart;
+  dirtyend = wn->dirtyend;
+
+  ln = vt_scrollback_add(vt, wn);
+  if (ln == wn)
+    return wn;
+
+  if (!ln || ln->line == VT_LINE_PACKED || ln->width != wn->width) {
+    vt_line_free(vt, ln);
+    ln = vt_line_alloc(vt, wn->width);
+  }
+  ln->line = line;
+  ln->modcount = modcount;
+  ln->dirtystart = dirtystart;
+  ln->dirtyend = dirtyend;
+  vt_ring_set(&vt->lines, row, ln);
+
+  return ln;
 }
 
 
+/*
+ * take the line at row 'from' and insert it blank at row 'to', 'count'
+ * times over.  the rows in between move up or down by one each time.
+ */
+static void
+vt_move_lines(struct vt_em *vt, int from, int to, int count)
+{
+  struct vt_line *wn;
+  uint32 blank = vt->attr & VTATTR_CLEARMASK;
+  int lines, i;
+
+  lines = (from < to ? to - from : from - to) + 1;
+
+  /* the same lines come round again after 'lines' moves, clearing
+     them where they are and rotating once gives the same result */
+  for (i=0;i<count && i<lines;i++) {
+    wn = (struct vt_line *)vt_ring_index(&vt->lines, from < to ? from + i : from - i);
+
+    /* clear it */
+    vt_simd_fill(wn->data, blank, wn->width);
+    wn->modcount=0;		/* set as 'unchanged' so the scroll
+				   routine can update it.
+				   but, if anyone else changes this line, make
+				   sure the rest of the screen is updated */
+    VT_LINE_CLEAN(wn);
+    wn->line = -1;		/* flag new line */
+  }
+
+  if (from < to)
+    vt_ring_rotate(&vt->lines, from, to+1, count);
+  else
+    vt_ring_rotate(&vt->lines, to, from+1, -count);
+}
+
 /**
  * vt_scroll_up:
  * @vt: An initialised &vt_em.
@@ -264,9 +544,9 @@ vt_scrollback_add(struct vt_em *vt, struct vt_line *wn)
 void
 vt_scroll_up(struct vt_em *vt, int count)
 {
-  struct vt_line *wn, *nn;
-  int i;
+  struct vt_line *wn;
   uint32 blank;
+  int lines, i;
 
   d(printf("vt_scroll_up count=%d top=%d bottom=%d\n", 
 	   count, vt->scrolltop, vt->scrollbottom));
@@ -276,38 +556,39 @@ vt_scroll_up(struct vt_em *vt, int count)
   if (count>vt->height)
     count=vt->height;
 
-  while (count>0) {
-    /* first, find the line to remove */
-    wn = (struct vt_line *)vt_list_index(&vt->lines, vt->scrolltop);
-    if (!wn)
-      {
-	g_error("could not find line %d\n", vt->scrolltop);
-      }
-
-    vt_list_remove((struct vt_listnode *)wn);
+  if (!vt_ring_index(&vt->lines, vt->scrolltop))
+    {
+      g_error("could not find line %d\n", vt->scrolltop);
+    }
 
+  /* lines leave the top of the scroll region in turn and come back
+     blank at its bottom.  blank them where they are, in the same
+     order, and rotate the region once afterwards */
+  lines = vt->scrollbottom - vt->scrolltop + 1;
+  for (i=0;i<count;i++) {
     if ((vt->scrolltop==0) && ((vt->mode&VTMODE_ALTSCREEN)==0)) {
-      vt_scrollback_add(vt, wn);
+      /* no copy, the line itself goes and another one is blanked */
+      wn = vt_scrollback_take(vt, vt->scrolltop + i % lines);
+    } else {
+      wn = (struct vt_line *)vt_ring_index(&vt->lines, vt->scrolltop + i % lines);
     }
 
-    for (i=0;i<wn->width;i++)
-      wn->data[i] = blank;
+    vt_simd_fill(wn->data, blank, wn->width);
 
     if (wn->line == -1) {
       wn->modcount = wn->width;	/* make sure a wrap-scrolled line isn't marked clean */
+      VT_LINE_DIRTY(wn, 0, wn->width);
     } else {
       wn->modcount = 0;		/* this speeds it up (heaps) but doesn't work :( */
+      VT_LINE_CLEAN(wn);
       wn->line=-1;		/* flag new line */
     }
-
-    /* insert it .. (on bottom of scroll area) */
-    nn=(struct vt_line *)vt_list_index(&vt->lines, vt->scrollbottom);
-    vt_list_insert(&vt->lines, (struct vt_listnode *)nn, (struct vt_listnode *)wn);
-
-    count--;
   }
 
-  vt->this_line = (struct vt_line *)vt_list_index(&vt->lines, vt->cursory);
+  /* and move them to the bottom of the scroll area */
+  vt_ring_rotate(&vt->lines, vt->scrolltop, vt->scrollbottom+1, count);
+
+  vt->this_line = (struct vt_line *)vt_ring_index(&vt->lines, vt->cursory);
 
   d(printf("vt_scroll_up() done\n"));
 }
@@ -324,39 +605,15 @@ vt_scroll_up(struct vt_em *vt, int count)
 void
 vt_scroll_down(struct vt_em *vt, int count)
 {
-  struct vt_line *wn, *nn;
-  int i;
-  uint32 blank = vt->attr & VTATTR_CLEARMASK;
-
   d(printf("vt_scroll_down count=%d top=%d bottom=%d\n",
 	   count, vt->scrolltop, vt->scrollbottom));
 
-  /* FIXME: do this properly */
-
   if (count>vt->height)
     count=vt->height;
 
-  while(count>0) {
-
-    /* first, find the line to remove */
-    wn=(struct vt_line *)vt_list_index(&vt->lines, vt->scrollbottom);
-    vt_list_remove((struct vt_listnode *)wn);
-    
-    /* clear it */
-    for (i=0;i<wn->width;i++) {
-      wn->data[i] = blank;
-    }
-    wn->modcount=0;
-    wn->line = -1;		/* flag new line */
-    
-    /* insert it .. (on bottom of scroll area) */
-    nn=(struct vt_line *)vt_list_index(&vt->lines, vt->scrolltop);
-    vt_list_insert(&vt->lines, (struct vt_listnode *)nn, (struct vt_listnode *)wn);
-
-    count--;
-  }
+  vt_move_lines(vt, vt->scrollbottom, vt->scrolltop, count);
 
-  vt->this_line = (struct vt_line *)vt_list_index(&vt->lines, vt->cursory);
+  vt->this_line = (struct vt_line *)vt_ring_index(&vt->lines, vt->cursory);
 }
 
 /**
@@ -369,7 +626,7 @@ vt_scroll_down(struct vt_em *vt, int count)
 void
 vt_insert_chars(struct vt_em *vt, int count)
 {
-  int i, j;
+  int j;
   struct vt_line *l;
 
   d(printf("vt_insert_chars(%d)\n", count));
@@ -379,22 +636,20 @@ vt_insert_chars(struct vt_em *vt, int count)
 
   /* scroll data over count bytes */
   j = (l->width-count)-vt->cursorx;
-  for (i=l->width-1;j>0;i--,j--) {
-    l->data[i] = l->data[i-count];
-  }
+  if (j>0)
+    vt_simd_move(&l->data[vt->cursorx+count], &l->data[vt->cursorx], j);
 
   /* clear the rest of the line */
-  for (i=vt->cursorx;i<vt->cursorx+count;i++) {
-    l->data[i] = vt->attr & VTATTR_CLEARMASK;
-  }
+  vt_simd_fill(&l->data[vt->cursorx], vt->attr & VTATTR_CLEARMASK, count);
   l->modcount+=count;
+  VT_LINE_DIRTY(l, vt->cursorx, l->width);
 }
 
 /* if this accesses more than this_line and cursorx, change vt_scroll_left */
 void
 vt_delete_chars(struct vt_em *vt, int count)
 {
-  int i, j;
+  int j;
   struct vt_line *l;
   uint32 blank;
 
@@ -406,16 +661,13 @@ vt_delete_chars(struct vt_em *vt, int count)
 
   /* scroll data over count bytes */
   j = (l->width-count)-vt->cursorx;
-  for (i=vt->cursorx;j>0;i++,j--) {
-    l->data[i] = l->data[i+count];
-  }
+  vt_simd_move(&l->data[vt->cursorx], &l->data[vt->cursorx+count], j);
 
   /* clear the rest of the line */
   blank = l->data[l->width-1] & VTATTR_CLEARMASK & VTATTR_MASK;
-  for (i=l->width-count;i<l->width;i++) {
-    l->data[i] = blank;
-  }
+  vt_simd_fill(&l->data[l->width-count], blank, count);
   l->modcount+=count;
+  VT_LINE_DIRTY(l, vt->cursorx, l->width);
 }
 
 /* erase characters */
@@ -426,113 +678,62 @@ vt_erase_chars(struct vt_em *vt, int count)
   int i;
 
   l = vt->this_line;
-  for (i = vt->cursorx; i<vt->cursorx+count && i<l->width;i++)
-    l->data[i] = vt->attr & VTATTR_CLEARMASK;
+  i = MIN(vt->cursorx + count, l->width);
+  if (i > vt->cursorx) {
+    vt_simd_fill(&l->data[vt->cursorx], vt->attr & VTATTR_CLEARMASK, i - vt->cursorx);
+    l->modcount += i - vt->cursorx;
+    VT_LINE_DIRTY(l, vt->cursorx, i);
+  }
 }
 
 void vt_insert_lines(struct vt_em *vt, int count)
 {
-  struct vt_line *wn, *nn;
-  int i;
-  uint32 blank = vt->attr & VTATTR_CLEARMASK;
-
   d(printf("vt_insert_lines(%d) (top = %d bottom = %d cursory = %d)\n",
 	   count, vt->scrolltop, vt->scrollbottom, vt->cursory));
 
-  /* FIXME: Do this properly */
-
   if (count>vt->height)
     count=vt->height;
 
-  while(count>0) {
-    /* first, find the line to remove */
-    wn=(struct vt_line *)vt_list_index(&vt->lines, vt->scrollbottom);
-    vt_list_remove((struct vt_listnode *)wn);
-    
-    /* clear it */
-    for (i=0;i<wn->width;i++) {
-      wn->data[i] = blank;
-    }
-    wn->modcount=0;		/* set as 'unchanged' so the scroll
-				   routine can update it.
-				   but, if anyone else changes this line, make
-				   sure the rest of the screen is updated */
-    /*wn->line=vt->cursory;*/		/* also 'fool' it into thinking the
-					   line is unchanged */
-    wn->line=-1;
-
-    /* insert it .. */
-    nn=(struct vt_line *)vt_list_index(&vt->lines, vt->cursory);
-    vt_list_insert(&vt->lines, (struct vt_listnode *)nn, (struct vt_listnode *)wn);
-
-    count--;
-  }
+  /* lines from the bottom of the scroll area are inserted at the cursor */
+  vt_move_lines(vt, vt->scrollbottom, vt->cursory, count);
 
-  vt->this_line = (struct vt_line *)vt_list_index(&vt->lines, vt->cursory);
+  vt->this_line = (struct vt_line *)vt_ring_index(&vt->lines, vt->cursory);
   n(vt->this_line);
 }
 
 void vt_delete_lines(struct vt_em *vt, int count)
 {
-  struct vt_line *wn, *nn;
-  int i;
-  uint32 blank = vt->attr & VTATTR_CLEARMASK;
-
   d(printf("vt_delete_lines(%d)\n", count));
-  /* FIXME: do this properly */
 
   /* range check! */
   if (count>vt->height)
     count=vt->height;
 
-  while (count>0) {
-    /* first, find the line to remove */
-    wn=(struct vt_line *)vt_list_index(&vt->lines, vt->cursory);
-    vt_list_remove((struct vt_listnode *)wn);
-    
-    /* clear it */
-    for (i=0;i<wn->width;i++) {
-      wn->data[i] = blank;
-    }
-    wn->modcount=0;
-    /*wn->line=vt->scrollbottom;*/
-    wn->line=-1;
-    
-    /* insert it .. (on bottom of scroll area) */
-    nn=(struct vt_line *)vt_list_index(&vt->lines, vt->scrollbottom);
-    vt_list_insert(&vt->lines, (struct vt_listnode *)nn, (struct vt_listnode *)wn);
-    
-    count--;
-  }
-  vt->this_line = (struct vt_line *)vt_list_index(&vt->lines, vt->cursory);
+  /* lines at the cursor are removed, and inserted at the bottom of the scroll area */
+  vt_move_lines(vt, vt->cursory, vt->scrollbottom, count);
+
+  vt->this_line = (struct vt_line *)vt_ring_index(&vt->lines, vt->cursory);
   n(vt->this_line);
 }
 
 void vt_clear_lines(struct vt_em *vt, int top, int count)
 {
-  struct vt_line *wn, *nn;
-  int i;
+  struct vt_line *wn;
   uint32 blank=vt->attr&VTATTR_CLEARMASK;
 
   d(printf("vt_clear_lines(%d, %d)\n", top, count));
-  i=1;
-  wn=(struct vt_line *)vt_list_index(&vt->lines, top);
-  nn=wn->next;
-  while(nn && count>=0) {
-    for(i=0;i<wn->width;i++) {
-      wn->data[i] = blank;
-    }
+  while((wn=(struct vt_line *)vt_ring_index(&vt->lines, top)) && count>=0) {
+    vt_simd_fill(wn->data, blank, wn->width);
     wn->modcount = wn->width;
+    VT_LINE_DIRTY(wn, 0, wn->width);
     count--;
-    wn=nn;
-    nn=nn->next;
+    top++;
   }
 }
 
 void vt_clear_line_portion(struct vt_em *vt, int start_col, int end_col)
 {
   struct vt_line *this_line;
-  int i;
   uint32 blank = vt->attr&VTATTR_CLEARMASK;
 
   d(printf("vt_clear_line_portion()\n"));
@@ -541,10 +742,11 @@ void vt_clear_line_portion(struct vt_em *vt, int start_col, int end_col)
   end_col = MIN(end_col, vt->width);
 
   this_line = vt->this_line;
-  for(i=start_col;i<end_col;i++) {
-    this_line->data[i] = blank;
-  }
   this_line->modcount+=(this_line->width-vt->cursorx);
+  if (start_col < end_col) {
+    vt_simd_fill(&this_line->data[start_col], blank, end_col - start_col);
+    VT_LINE_DIRTY(this_line, start_col, end_col);
+  }
 }
 
 /*
@@ -566,7 +768,7 @@ void vt_reset_terminal(struct vt_em *vt, int hard)
   if (hard) {
     vt->cursorx=0;
     vt->cursory=0;
-    vt->this_line = (struct vt_line *)vt->lines.head;
+    vt->this_line = (struct vt_line *)vt_ring_index(&vt->lines, 0);
     vt_set_screen(vt, 0);
     vt_clear_lines(vt, 0, vt->height);
   }
@@ -600,10 +802,10 @@ static void vt_lf(struct vt_em *vt)
       && (vt->cursory < vt->height-1)) {
     vt->cursory++;
     d(printf("new ypos = %d\n", vt->cursory));
-    vt->this_line = vt->this_line->next;
+    vt->this_line = (struct vt_line *)vt_ring_index(&vt->lines, vt->cursory);
   } else {
     vt_scroll_up(vt, 1);
-    vt->this_line = (struct vt_line *)vt_list_index(&vt->lines, vt->cursory);
+    vt->this_line = (struct vt_line *)vt_ring_index(&vt->lines, vt->cursory);
   }
   n(vt->this_line);
 }
@@ -623,7 +825,6 @@ static void vt_tab(struct vt_em *vt)
 
   d(printf("tab\n"));
 
-  l = vt->this_line;
   if (vt->cursorx>=vt->width) {
       if (!(vt->mode & VTMODE_WRAPOFF)) {
 	  vt->cursorx = 0;
@@ -631,6 +832,8 @@ static void vt_tab(struct vt_em *vt)
       } else
 	  return;
   }
+  /* after the line feed, a scrolled out line is in the scrollback */
+  l = vt->this_line;
   c = l->data[vt->cursorx] & VTATTR_DATAMASK;
 
   /* dont store tab over a space - will affect attributes */
@@ -639,6 +842,7 @@ static void vt_tab(struct vt_em *vt)
      * with respect to attributes
      */
     l->data[vt->cursorx] = 9 | (l->data[vt->cursorx]&VTATTR_MASK);
+    VT_LINE_DIRTY(l, vt->cursorx, vt->cursorx+1);
   }
 
   /* move cursor to new tab position */
@@ -699,17 +903,15 @@ static void vt_scroll_forward(struct vt_em *vt)
 /* insert 'count' columns from 'startx' */
 static void vt_insert_columns(struct vt_em *vt, int startx, int count)
 {
-  struct vt_line *l, *oldthis;
-  int oldx;
+  struct vt_line *oldthis;
+  int oldx, i;
 
   oldthis = vt->this_line;
   oldx = vt->cursorx;
   vt->cursorx = startx;
-  l = (struct vt_line *)vt->lines.head;
-  while (l->next) {
-    vt->this_line = l;
+  for (i=0;i<vt->lines.count;i++) {
+    vt->this_line = (struct vt_line *)vt_ring_index(&vt->lines, i);
     vt_insert_chars(vt, count);
-    l = l->next;
   }
   vt->this_line = oldthis;
   vt->cursorx = oldx;
@@ -717,17 +919,15 @@ static void vt_insert_columns(struct vt_em *vt, int startx, int count)
 
 static void vt_delete_columns(struct vt_em *vt, int startx, int count)
 {
-  struct vt_line *l, *oldthis;
-  int oldx;
+  struct vt_line *oldthis;
+  int oldx, i;
 
   oldthis = vt->this_line;
   oldx = vt->cursorx;
   vt->cursorx = startx;
-  l = (struct vt_line *)vt->lines.head;
-  while (l->next) {
-    vt->this_line = l;
+  for (i=0;i<vt->lines.count;i++) {
+    vt->this_line = (struct vt_line *)vt_ring_index(&vt->lines, i);
     vt_delete_chars(vt, count);
-    l = l->next;
   }
   vt->this_line = oldthis;
   vt->cursorx = oldx;
@@ -810,7 +1010,7 @@ vt_delete_line(struct vt_em *vt)
     vt_delete_lines(vt, vt->arg.num.intargs[0]?vt->arg.num.intargs[0]:1);
   }
 
-  vt->this_line = (struct vt_line *)vt_list_index(&vt->lines, vt->cursory);
+  vt->this_line = (struct vt_line *)vt_ring_index(&vt->lines, vt->cursory);
   n(vt->this_line);
 }
 
@@ -884,7 +1084,7 @@ vt_restore_cursor(struct vt_em *vt)
   if (vt->cursory >= vt->height)
     vt->cursory = vt->height-1;
 
-  vt->this_line = (struct vt_line *)vt_list_index(&vt->lines, vt->cursory);
+  vt->this_line = (struct vt_line *)vt_ring_index(&vt->lines, vt->cursory);
   n(vt->this_line);
   d(printf("found line %d, %p\n", vt->cursory, vt->this_line));
 }
@@ -978,7 +1178,7 @@ vt_gotoxy(struct vt_em *vt, int x, int y)
   vt->cursorx=x;
   d(printf("pos = %d %d\n", vt->cursory, vt->cursorx));
 
-  vt->this_line = (struct vt_line *)vt_list_index(&vt->lines, vt->cursory);
+  vt->this_line = (struct vt_line *)vt_ring_index(&vt->lines, vt->cursory);
   n(vt->this_line);
 }
 
@@ -1358,11 +1558,9 @@ vt_set_text(struct vt_em *vt)
   char *utf8;
   
   if (vt->change_my_name) {
-    p = strchr(vt->arg.txt.args_mem, ';');
+    p = vt->osc.buf;
     if (p) {
-      *p=0;
-      p++;
-      i = atoi(vt->arg.txt.args_mem);
+      i = vt->osc.command;
       switch(i) {
       case 0:
 	i = VTTITLE_WINDOWICON;
@@ -1423,112 +1621,483 @@ vt_set_text(struct vt_em *vt)
   }
 }
 
-struct vt_jump {
-  void (*process)(struct vt_em *vt);	/* process function */
-  int modes;			/* modes appropriate */
-};
+/* the payload of a title string is buffered for vt_set_text() */
+#define VTOSC_TITLE 3
 
-#define VT_LIT 0x01		/* literal */
-#define VT_CON 0x02		/* control character */
-#define VT_EXB 0x04		/* escape [ sequence */
-#define VT_EXO 0x08		/* escape O sequence */
-#define VT_ESC 0x10		/* escape "x" sequence */
-#define VT_ARG 0x20		/* character is a possible argument to function (only digits!) */
-#define VT_EXA 0x40		/* escape x "x" sequence */
+/*
+  start of an OSC string, after '\E]'
+*/
+static void
+vt_osc_start(struct vt_em *vt)
+{
+  vt->osc.len = 0;
+  vt->osc.command = 0;
+  vt->osc.payload = 0;
+  vt->osc.handling = VTOSC_IGNORE;
+}
 
-#define VT_EBL (VT_EXB|VT_LIT)	/* escape [ or literal */
-#define VT_EXL (VT_ESC|VT_LIT)	/* escape "x" or literal */
-#define VT_BOL (VT_EBL|VT_EXO)	/* escape [, escape O, or literal */
+/*
+  the OSC number has been read, find out what to do with the payload.
+  titles are buffered for vt_set_text() unless the handler takes them.
+*/
+static void
+vt_osc_command(struct vt_em *vt)
+{
+  vt->osc.payload = 1;
 
-struct vt_jump vtjumps[] = {
-  {0,0}, {0,0}, {0,0}, {0,0},	/* 0: ^@ ^C */
-  {0,0}, {0,0}, {0,0}, {vt_bell,VT_CON},	/* 4: ^D ^G */
-  {vt_backspace,VT_CON}, {vt_tab,VT_CON}, {vt_lf,VT_CON}, {0,0},	/* 8: ^H ^K */
-  {0,0}, {vt_cr,VT_CON}, {vt_alt_start,VT_CON}, {vt_alt_end,VT_CON},	/* c: ^L ^O */
-  {0,0}, {0,0}, {0,0}, {0,0},	/* 10: ^P ^S */
-  {0,0}, {0,0}, {0,0}, {0,0},	/* 14: ^T ^W */
-  {0,0}, {0,0}, {0,0}, {0,0},	/* 18: ^X ^[ */
-  {0,0}, {0,0}, {0,0}, {0,0},	/* 1c: ^\ ^] ^^ ^_  */
-  {0,VT_LIT}, {0,VT_LIT}, {0,VT_LIT}, {vt_deccharmode,VT_LIT|VT_EXA},	/*  !"# */
-  {0,VT_LIT}, {vt_char_encoding,VT_LIT|VT_EXA}, {0,VT_LIT}, {0,VT_LIT},	/* $%&' */
-  {vt_gx_set,VT_LIT|VT_EXA}, {vt_gx_set,VT_LIT|VT_EXA}, {vt_gx_set,VT_LIT|VT_EXA}, {vt_gx_set,VT_LIT|VT_EXA},	/* ()*+ */
-  {0,VT_LIT}, {0,VT_LIT}, {0,VT_LIT}, {0,VT_LIT},	/* ,-./ */
-  {0,VT_LIT|VT_ARG}, {0,VT_LIT|VT_ARG}, {0,VT_LIT|VT_ARG}, {0,VT_LIT|VT_ARG},	/* 0123 */
-  {0,VT_LIT|VT_ARG}, {0,VT_LIT|VT_ARG}, {0,VT_LIT|VT_ARG}, {vt_save_cursor,VT_EXL|VT_ARG},	/* 4567 */
-  {vt_restore_cursor,VT_EXL|VT_ARG}, {0,VT_LIT|VT_ARG}, {0,VT_LIT}, {0,VT_LIT},	/* 89:; */
-  {0,VT_LIT}, {vt_keypadon,VT_EXL}, {vt_keypadoff,VT_EXL}, {0,VT_LIT},	/* <=>? */
-  {vt_insert_char,VT_EBL}, {vt_up,VT_BOL}, {vt_down,VT_BOL}, {vt_right,VT_BOL},	/* @ABC */
-  {vt_left,VT_BOL|VT_ESC}, {vt_nl,VT_EXL}, {0,VT_LIT}, {vt_gotoabsx,VT_EBL},	/* DEFG */
-  {vt_goto,VT_EBL}, {0,VT_LIT}, {vt_cleareos,VT_EBL}, {vt_clear_lineportion,VT_EBL},	/* HIJK */
-  {vt_insert_line,VT_EBL}, {vt_delete_line,VT_EBL|VT_ESC}, {0,VT_LIT}, {0,VT_LIT},	/* LMNO */
-  {vt_delete_char,VT_EBL}, {0,VT_LIT}, {0,VT_LIT}, {vt_scroll_forward,VT_EBL},	/* PQRS */
-  {vt_scroll_reverse,VT_EBL}, {0,VT_LIT}, {0,VT_LIT}, {0,VT_LIT},	/* TUVW */
-  {vt_erase_char,VT_EBL}, {0,VT_LIT}, {vt_backtab,VT_EBL}, {0,VT_LIT},	/* XYZ[ */
-  {0,VT_LIT}, {0,VT_LIT}, {vt_scroll_reverse,VT_EBL}, {0,VT_LIT},	/* \]^_ */
-  {0,VT_LIT}, {0,VT_LIT}, {0,VT_LIT}, {vt_reset,VT_EXL|VT_EXB},	/* `abc */
-  {vt_gotoabsy,VT_EBL|VT_ESC}, {0,VT_LIT}, {vt_goto,VT_EBL}, {0,VT_LIT},	/* defg */
-  {vt_modeh,VT_EBL}, {0,VT_LIT}, {0,VT_LIT}, {vt_modek,VT_EBL},	/* hijk */
-  {vt_model,VT_EBL}, {vt_mode,VT_EBL}, {vt_dsr,VT_EBL}, {0,VT_LIT},	/* lmno */
-  {vt_reset,VT_EBL}, {0,VT_LIT}, {vt_scroll,VT_EBL}, {0,VT_LIT},	/* pqrs */
-  {0,VT_LIT}, {0,VT_LIT}, {0,VT_LIT}, {0,VT_LIT},	/* tuvw */
-  {0,VT_LIT}, {0,VT_LIT}, {0,VT_LIT}, {0,VT_LIT},	/* xyz{ */
-  {0,VT_LIT}, {vt_decic,VT_EBL}, {vt_func,VT_EBL}, {0,VT_LIT},	/* |}~? */
-};
+  if (vt->osc.command < 0)
+    return;
 
-/**
- * vt_parse_vt:
- * @vt: An initialised &vt_em.
- * @ptr: Text to parse.
- * @length: Length of text available at @ptr
- *
- * Parses a sequence of characters using an xterm compatible
- * terminal state machine.  All state and terminal output is
- * stored in @vt.
- */
-void
-vt_parse_vt (struct vt_em *vt, char *ptr, int length)
-{
-  register int c;
-  register int state;
-  register int mode;
-  struct vt_jump *modes = vtjumps;
-  char *ptr_end;
-  void (*process)(struct vt_em *vt);	/* process function */
+  if (vt->osc_handler)
+    vt->osc.handling = vt->osc_handler(vt->user_data, vt->osc.command, VTOSC_START, NULL, 0);
 
-  /* states:
-   *   0: normal escape mode
-   *   1: escape mode.  switch on next character.
-   *   2: '[' escape mode (keep finding numbers until a command code found)
-   *   3: 'O' escape mode.  switch on next character.
-   *   4: ']' escape mode.  swallows until following bell (or newline).
-   *   5: '\Exy' sequence.
-   *   6: '\E[?nn;...y' escape sequence.
-   *   7: '\E[.... X' escape sequence.
-   *   8: '\E[!X' escape sequence.
-   *   9: '\E[....'X' escape sequence.
-   *  10: '\E[>....X' escape sequence.
-   *
-   *   DO NOT CHANGE THESE STATES!  Some callbacks rely on them.
-   */
+  if (vt->osc.handling == VTOSC_IGNORE && vt->change_my_name && vt->osc.command <= 3)
+    vt->osc.handling = VTOSC_TITLE;
+}
 
-  state = vt->state;
-  ptr_end = ptr + length;
-  while (ptr < ptr_end) {
+/*
+  a piece of OSC payload, passed on or appended to the buffer.  the
+  buffer grows by doubling, up to VTPARAM_OSCMAX.
+*/
+static void
+vt_osc_data(struct vt_em *vt, const char *data, int len)
+{
+  int size;
 
-    /* convert to unsigned byte */
-    c = (*ptr++) & 0xff;
+  switch (vt->osc.handling) {
+  case VTOSC_STREAM:
+    vt->osc_handler(vt->user_data, vt->osc.command, VTOSC_DATA, data, len);
+    break;
 
-#ifdef ZVT_UTF
+  case VTOSC_BUFFER:
+  case VTOSC_TITLE:
+    if (len > VTPARAM_OSCMAX - 1 - vt->osc.len)
+      len = VTPARAM_OSCMAX - 1 - vt->osc.len;
+    if (vt->osc.len + len >= vt->osc.size) {
+      size = vt->osc.size ? vt->osc.size : 256;
+      while (vt->osc.len + len >= size)
+	size *= 2;
+      vt->osc.buf = g_realloc(vt->osc.buf, size);
+      vt->osc.size = size;
+    }
+    memcpy(vt->osc.buf + vt->osc.len, data, len);
+    vt->osc.len += len;
+    break;
+  }
+}
 
-    if (vt->coding == ZVT_CODE_UTF8 && (c&0x80)!=0) {
-      if (c<0xc0) {
+/*
+  done with an OSC string.  large buffers are not kept around for the
+  next one.
+*/
+static void
+vt_osc_done(struct vt_em *vt)
+{
+  if (vt->osc.size > 4096) {
+    g_free(vt->osc.buf);
+    vt->osc.buf = NULL;
+    vt->osc.size = 0;
+  }
+
+  vt->osc.handling = VTOSC_IGNORE;
+}
+
+/*
+  end of an OSC string, by BEL or ST
+*/
+static void
+vt_osc_end(struct vt_em *vt)
+{
+  switch (vt->osc.handling) {
+  case VTOSC_STREAM:
+    vt->osc_handler(vt->user_data, vt->osc.command, VTOSC_END, NULL, 0);
+    break;
+
+  case VTOSC_BUFFER:
+  case VTOSC_TITLE:
+    /* a string without payload still gets its buffer */
+    vt_osc_data(vt, "", 0);
+    vt->osc.buf[vt->osc.len] = 0;
+    d(printf("received text mode: %d;%s\n", vt->osc.command, vt->osc.buf));
+
+    if (vt->osc.handling == VTOSC_TITLE)
+      vt_set_text(vt);
+    else
+      vt->osc_handler(vt->user_data, vt->osc.command, VTOSC_END, vt->osc.buf, vt->osc.len);
+    break;
+  }
+
+  vt_osc_done(vt);
+}
+
+/*
+  an OSC string was interrupted by a line feed or an escape sequence
+*/
+static void
+vt_osc_cancel(struct vt_em *vt)
+{
+  if (vt->osc.handling == VTOSC_STREAM || vt->osc.handling == VTOSC_BUFFER)
+    vt->osc_handler(vt->user_data, vt->osc.command, VTOSC_CANCEL, NULL, 0);
+
+  vt_osc_done(vt);
+}
+
+struct vt_jump {
+  void (*process)(struct vt_em *vt);	/* process function */
+  int modes;			/* modes appropriate */
+};
+
+struct vt_jump vtjumps[] = {
+#define VT_JUMP(process, modes) {process, modes}
+#include "vtjumps.def"
+#undef VT_JUMP
+};
+
+/*
+  wrap the cursor before a character is output at the end of the line
+*/
+static inline void
+vt_literal_wrap(struct vt_em *vt)
+{
+  if (vt->cursorx>=vt->width) {
+    if (vt->mode&VTMODE_WRAPOFF)
+      vt->cursorx = vt->width-1;
+    else {
+      vt_lf(vt);
+      vt->cursorx=0;
+    }
+  }
+}
+
+/*
+  make room for up to n literals at the cursor, by wrapping or, in
+  insert mode, by shifting the rest of the line once for all of them.
+
+  returns the number of literals that fit on the line.
+*/
+static inline int
+vt_literal_room(struct vt_em *vt, int n)
+{
+  if ((vt->mode & VTMODE_INSERT) && vt->cursorx < vt->width) {
+    n = MIN(n, vt->width - vt->cursorx);
+    vt_insert_chars(vt, n);
+    return n;
+  }
+
+  vt_literal_wrap(vt);
+
+  /* like in the byte loop, the character following a wrap is not inserted */
+  if (vt->mode & VTMODE_INSERT)
+    return 1;
+
+  return MIN(n, vt->width - vt->cursorx);
+}
+
+/*
+  store a run of printable ascii characters from the normal state,
+  stopping at the end of the line.
+
+  returns the number of characters consumed.
+*/
+static int
+vt_put_literals(struct vt_em *vt, const unsigned char *p, int n)
+{
+  uint32 attr = vt->attr & VTATTR_MASK;
+  uint32 *data;
+  int i;
+
+  n = vt_literal_room(vt, n);
+
+  data = &vt->this_line->data[vt->cursorx];
+
+  /* remap characters? */
+  if (vt->remaptable) {
+    for (i=0;i<n;i++)
+      data[i] = attr | vt->remaptable[p[i]];
+  } else
+    vt_simd_expand(data, p, n, attr);
+
+  vt->this_line->modcount += n;
+  VT_LINE_DIRTY(vt->this_line, vt->cursorx, vt->cursorx + n);
+  vt->cursorx += n;
+
+  return n;
+}
+
+#ifdef ZVT_UTF
+/*
+  store decoded characters from the normal state, wrapping lines
+  as needed.
+*/
+static void
+vt_put_chars(struct vt_em *vt, const uint32 *chars, int n)
+{
+  uint32 attr = vt->attr & VTATTR_MASK;
+  uint32 *data;
+  uint32 c;
+  int i, count;
+
+  while (n > 0) {
+    count = vt_literal_room(vt, n);
+    data = &vt->this_line->data[vt->cursorx];
+
+    for (i=0;i<count;i++) {
+      c = chars[i];
+      /* remap character? */
+      if (vt->remaptable && c<=0xff)
+	c = vt->remaptable[c];
+      data[i] = attr | c;
+    }
+
+    vt->this_line->modcount += count;
+    VT_LINE_DIRTY(vt->this_line, vt->cursorx, vt->cursorx + count);
+    vt->cursorx += count;
+    chars += count;
+    n -= count;
+  }
+}
+
+/*
+  decode a run of well-formed utf-8 text from the normal state, as
+  long as no control character, malformed or truncated sequence is
+  found.  these are left to the byte state machine.
+
+  returns the number of bytes consumed.
+*/
+static int
+vt_put_utf8(struct vt_em *vt, const unsigned char *p, int n)
+{
+  uint32 chars[256];
+  uint32 c;
+  int i = 0, count, len;
+
+  /* control characters end the run, so only the sequences need checking */
+  n = vt_simd_text(p, n);
+
+  while (i < n) {
+    count = 0;
+
+    while (i < n && count < 256) {
+      c = p[i];
+      if (c < 0x80) {
+	len = 1;
+      } else if (c < 0xc2) {
+	break;			/* continuation byte or overlong */
+      } else if (c < 0xe0) {
+	if (i + 1 >= n || (p[i+1] & 0xc0) != 0x80)
+	  break;
+	c = ((c & 0x1f) << 6) | (p[i+1] & 0x3f);
+	len = 2;
+      } else if (c < 0xf0) {
+	if (i + 2 >= n || (p[i+1] & 0xc0) != 0x80 || (p[i+2] & 0xc0) != 0x80)
+	  break;
+	c = ((c & 0x0f) << 12) | ((p[i+1] & 0x3f) << 6) | (p[i+2] & 0x3f);
+	if (c < 0x800 || (c >= 0xd800 && c < 0xe000))
+	  break;
+	len = 3;
+      } else if (c < 0xf5) {
+	if (i + 3 >= n || (p[i+1] & 0xc0) != 0x80 || (p[i+2] & 0xc0) != 0x80 || (p[i+3] & 0xc0) != 0x80)
+	  break;
+	c = ((c & 0x07) << 18) | ((p[i+1] & 0x3f) << 12) | ((p[i+2] & 0x3f) << 6) | (p[i+3] & 0x3f);
+	if (c < 0x10000 || c > 0x10ffff)
+	  break;
+	len = 4;
+      } else {
+	break;
+      }
+
+      chars[count++] = c;
+      i += len;
+    }
+
+    if (count == 0)
+      break;
+
+    vt_put_chars(vt, chars, count);
+
+    if (count < 256)
+      break;
+  }
+
+  return i;
+}
+#endif /* ZVT_UTF */
+
+/*
+  count the line feeds in the text following a line feed, as long as
+  nothing but literals and controls that only move the cursor along
+  the line are seen.  utf-8 sequences that could decode to a control
+  stop the count.
+*/
+static int
+vt_count_lf(struct vt_em *vt, const unsigned char *p, const unsigned char *end, int max)
+{
+  const struct vt_transition *t;
+  int count = 0, len;
+
+  while (p < end && count < max) {
+    p += vt_simd_printable(p, end - p);
+    if (p == end)
+      break;
+
+    switch (*p) {
+    case '\n':
+      count++;
+      /* fall through */
+    case '\r':
+    case '\t':
+    case '\b':
+    case 7:
+      p++;
+      continue;
+    }
+
+#ifdef ZVT_UTF
+    if (vt->coding == ZVT_CODE_UTF8 && (*p & 0x80)) {
+      /* only sequences of U+00c0 and above, without overlongs */
+      if (*p >= 0xc3 && *p <= 0xdf)
+	len = 2;
+      else if (*p >= 0xe0 && *p <= 0xef && (*p != 0xe0 || p + 1 >= end || p[1] >= 0xa0))
+	len = 3;
+      else if (*p >= 0xf0 && *p <= 0xf4 && (*p != 0xf0 || p + 1 >= end || p[1] >= 0x90))
+	len = 4;
+      else
+	break;
+
+      /* a sequence continued in the next chunk ends the count */
+      if (end - p < len)
+	break;
+      while (--len > 0 && (*++p & 0xc0) == 0x80)
+	;
+      if (len > 0)
+	break;
+      p++;
+      continue;
+    }
+#endif
+
+    t = &vt_transitions[0][vt_byte_class[*p]];
+    if (t->state != 0 || (t->action != VT_ACTION_NONE && t->action != VT_ACTION_PRINT))
+      break;
+    p++;
+  }
+
+  return count;
+}
+
+/*
+  a line feed at the bottom of the scroll region, followed by more of
+  them: scroll once for all the line feeds that are coming, and move the
+  cursor up so they end up on the bottom line again.  only the text
+  between them will land on the lines scrolled in.
+
+  returns 0 if there was nothing to coalesce.
+*/
+static int
+vt_scroll_lf(struct vt_em *vt, const unsigned char *p, const unsigned char *end)
+{
+  int count;
+
+  count = 1 + vt_count_lf(vt, p, end, vt->scrollbottom - vt->scrolltop);
+  if (count < 2)
+    return 0;
+
+  vt->cursory -= count - 1;
+  vt_scroll_up(vt, count);
+  n(vt->this_line);
+
+  return 1;
+}
+
+/**
+ * vt_parse_vt:
+ * @vt: An initialised &vt_em.
+ * @ptr: Text to parse.
+ * @length: Length of text available at @ptr
+ *
+ * Parses a sequence of characters using an xterm compatible
+ * terminal state machine.  All state and terminal output is
+ * stored in @vt.
+ */
+void
+vt_parse_vt (struct vt_em *vt, char *ptr, int length)
+{
+  register int c;
+  register int state;
+  register int class;
+  const struct vt_transition *transition;
+  char *ptr_end;
+
+  /* states:
+   *   0: normal escape mode
+   *   1: escape mode.  switch on next character.
+   *   2: '[' escape mode (keep finding numbers until a command code found)
+   *   3: 'O' escape mode.  switch on next character.
+   *   4: ']' escape mode.  swallows until following bell (or newline).
+   *   5: '\Exy' sequence.
+   *   6: '\E[?nn;...y' escape sequence.
+   *   7: '\E[.... X' escape sequence.
+   *   8: '\E[!X' escape sequence.
+   *   9: '\E[....'X' escape sequence.
+   *  10: '\E[>....X' escape sequence.
+   *  11: '\E' within ']' escape mode, '\' ends it.
+   *
+   *   DO NOT CHANGE THESE STATES!  Some callbacks rely on them.
+   */
+
+  state = vt->state;
+  ptr_end = ptr + length;
+  while (ptr < ptr_end) {
+
+    /* so is the payload of OSC strings, up to the BEL or ST */
+    if (state == 4 && vt->osc.payload) {
+      int run = vt_simd_string((unsigned char *)ptr, ptr_end - ptr);
+
+      if (run > 0) {
+	vt->state = state;
+	vt_osc_data(vt, ptr, run);
+	ptr += run;
+	continue;
+      }
+    }
+
+    /* runs of printable ascii in the normal state are stored in one go */
+    if (state == 0) {
+      int run = vt_simd_printable((unsigned char *)ptr, ptr_end - ptr);
+
+      if (run > 0) {
+	vt->state = state;
+	ptr += vt_put_literals(vt, (unsigned char *)ptr, run);
+	continue;
+      }
+
+#ifdef ZVT_UTF
+      /* so are runs of utf-8 text, unless a sequence is pending */
+      if (vt->coding == ZVT_CODE_UTF8 && (*ptr & 0xc0) == 0xc0
+	  && (vt->decode.utf8.shiftchar & 0x80) == 0) {
+	vt->state = state;
+	run = vt_put_utf8(vt, (unsigned char *)ptr, ptr_end - ptr);
+	if (run > 0) {
+	  ptr += run;
+	  continue;
+	}
+      }
+#endif
+    }
+
+    /* convert to unsigned byte */
+    c = (*ptr++) & 0xff;
+
+#ifdef ZVT_UTF
+
+    if (vt->coding == ZVT_CODE_UTF8 && (c&0x80)!=0) {
+      if (c<0xc0) {
 	/* might be part of a multi-byte content ... */
 	if ((vt->decode.utf8.shiftchar & 0x80) == 0) {
 	  /* treat this character as a control character/international character.
 	     This (0x80-0xc0] should cover the C1 control set and some of the
 	     international characters in normal latin 1, but not all :( */
-	  mode = modes[c & 0x7f].modes;
-	  process = modes[c & 0x7f].process;
+	  class = vt_byte_class[c];
 	} else {
 	  vt->decode.utf8.shiftchar <<= 1;
 	  vt->decode.utf8.wchar = (vt->decode.utf8.wchar<<6) | (c&0x3f);
@@ -1538,8 +2107,7 @@ vt_parse_vt (struct vt_em *vt, char *ptr, int length)
 	    vt->decode.utf8.shiftchar=0;
 
 	    /* all extended characters are just literals */
-	    mode = VT_LIT;
-	    process = 0;
+	    class = (unsigned int)c < 0x80 ? vt_decoded_class[c] : VT_CLASS_DECODED;
 	  } else {
 	    vt->decode.utf8.shift+=5;
 	    continue;
@@ -1551,187 +2119,369 @@ vt_parse_vt (struct vt_em *vt, char *ptr, int length)
 	vt->decode.utf8.shift=4;
 	continue;
       }
-    } else {
-      mode = modes[c & 0x7f].modes;
-      process = modes[c & 0x7f].process;
-    }
+    } else
+      class = vt_byte_class[c];
 #else
-    mode = modes[c & 0x7f].modes;
-    process = modes[c & 0x7f].process;
+    class = vt_byte_class[c];
 #endif /* ZVT_UTF */
 
     vt->state = state;		/* so callbacks know their state */
     
     d(printf("state %d: %d $%02x '%c'\n",state, vt->argcnt, c, isprint(c)?c:'.'));
-    
-    switch (state) {
-      
-    case 0:
-      if (mode & VT_LIT) {
-	/* remap character? */
-	if (vt->remaptable && c<=0xff)
-	  c=vt->remaptable[c];
-	
-	/* insert mode? */
-	if (vt->mode & VTMODE_INSERT)
-	  vt_insert_chars(vt, 1);
-	
-	/* need to wrap? */
-	if (vt->cursorx>=vt->width) {
-	  if (vt->mode&VTMODE_WRAPOFF)
-	    vt->cursorx = vt->width-1;
-	  else {
-	    vt_lf(vt);
-	    vt->cursorx=0;
-	  }
-	}
+
+    /* the transitions are generated from vtjumps by vtgen */
+    transition = &vt_transitions[state][class];
+
+    /* an escape sequence other than ST within an OSC string cancels it */
+    if (state == 11 && transition->action != VT_ACTION_OSC_END)
+      vt_osc_cancel(vt);
+
+    switch (transition->action) {
+
+    case VT_ACTION_PRINT:
+      /* remap character? */
+      if (vt->remaptable && c<=0xff)
+	c=vt->remaptable[c];
 	
-	/* output character */
-	vt->this_line->data[vt->cursorx] = ((vt->attr) & VTATTR_MASK) | c;
-	vt->this_line->modcount++;
-	/* d(printf("literal %c\n", c)); */
-	vt->cursorx++;
-      } else if (mode & VT_CON) {
-	process(vt);
-      } else if (c==27) {
-	state=1;
-      }
-      /* else ignore */
+      /* insert mode? */
+      if (vt->mode & VTMODE_INSERT)
+	vt_insert_chars(vt, 1);
+
+      vt_literal_wrap(vt);
+
+      /* output character */
+      vt->this_line->data[vt->cursorx] = ((vt->attr) & VTATTR_MASK) | c;
+      vt->this_line->modcount++;
+      VT_LINE_DIRTY(vt->this_line, vt->cursorx, vt->cursorx + 1);
+      /* d(printf("literal %c\n", c)); */
+      vt->cursorx++;
       break;
-      
-      
-      /* received 'esc', next byte */
-    case 1:
-      if (mode & VT_ESC) {	/* got a \Ex sequence */
-	vt->argcnt = 0;
-	vt->arg.num.intargs[0] = 0;
-	process(vt);
-	state=0;
-      } else if (c=='[') {
-	vt->arg.num.intarg = 0;
-	vt->argcnt = 0;
-	state = 2;
-      } else if (c=='O') {
-	state = 3;
-      } else if (c==']') {	/* set text parameters, read parameters */
-	state = 4;
-	vt->arg.txt.outptr = vt->arg.txt.args_mem;
-      } else if (mode & VT_EXA) {
-	vt->arg.num.intargs[0] = c & 0x7f;
-	state = 5;
-      } else {
-	state = 0;		/* dont understand input */
-      }
+
+    case VT_ACTION_PROCESS:
+      /* line feed floods scroll the screen once per chunk */
+      if (c == '\n' && state == 0 && vt->cursory == vt->scrollbottom
+	  && vt_scroll_lf(vt, (unsigned char *)ptr, (unsigned char *)ptr_end))
+	break;
+      vtjumps[c & 0x7f].process(vt);
       break;
-      
-      
-    case 2:
-      if (c=='?') {
-	state = 6;
-	continue;
-      } else if (c=='>') {
-	state = 10;
-	continue;
-      } else if (c=='!') {
-	state = 8;
-	continue;
-      }
-      /* note -> falls through */
-    case 6:
-    case 7:
-    case 8:
-    case 9:
-    case 10:
-      if (mode & VT_ARG) {
-	/* accumulate subtotal */
-	vt->arg.num.intarg = vt->arg.num.intarg*10+(c-'0');
-      } else if ((mode & VT_EXB) || c==';' || c==':') {	/* looking for 'arg;arg;...' */
-	if (vt->argcnt < VTPARAM_INTARGS) {
-	  vt->arg.num.intargs[vt->argcnt] = vt->arg.num.intarg & 0x7fffffff;
-	  vt->argcnt++;
-	  vt->arg.num.intarg = 0;
-	}
-	if (mode & VT_EXB) {
-	  process(vt);
-	  state=0;
-	}
-      } else if (mode & VT_CON) {
-	process(vt);
-      } else if (c==' ') {	/* this expects the next char == VT_EXB.  close enough! */
-	state = 7;		/* any other chars should be numbers anyway */
-      } else if (c=='\'') {
-	state = 9;
-      } else {
-	d(printf("unknown option '%c'\n", c));
-	state=0;		/* unexpected escape sequence - ignore */
-      }
+
+      /* got a \Ex sequence */
+    case VT_ACTION_ESCAPE:
+      vt->argcnt = 0;
+      vt->arg.num.intargs[0] = 0;
+      vtjumps[c & 0x7f].process(vt);
       break;
-      
-      
+
+    case VT_ACTION_CSI:
+      vt->arg.num.intarg = 0;
+      vt->argcnt = 0;
+      break;
+
       /* \EOx */
-    case 3:
-      if (mode & VT_EXO) {
-	vt->arg.num.intargs[0] = 0;
-	process(vt);
-      }	/* ignore otherwise */
-      state=0;
+    case VT_ACTION_SS3:
+      vt->arg.num.intargs[0] = 0;
+      vtjumps[c & 0x7f].process(vt);
       break;
-      
-      
-      /* \E]..;...BEL */
-    case 4:
-      if (c==0x07) {
-	/* handle output */
-	*(vt->arg.txt.outptr)=0;
-	vt_set_text(vt);
-	d(printf("received text mode: %s\n", vt->arg.txt.args_mem));
-	state = 0;
-      } else if (c==0x0a) {
-	state = 0;		/* abort command */
-      } else {
-	if (vt->arg.txt.outptr<(vt->arg.txt.args_mem+VTPARAM_MAXARGS*VTPARAM_ARGMAX-2)) /* truncate excessive args */
-	  *(vt->arg.txt.outptr)++=c;
+
+      /* \E]..;...BEL, set text parameters, read parameters */
+    case VT_ACTION_OSC:
+      vt_osc_start(vt);
+      break;
+
+    case VT_ACTION_OSC_CHAR:
+      if (vt->osc.payload) {
+	char ch = c;
+	vt_osc_data(vt, &ch, 1);
+      } else if (c == ';')
+	vt_osc_command(vt);
+      else if (c >= '0' && c <= '9' && vt->osc.command >= 0 && vt->osc.command < 100000)
+	vt->osc.command = vt->osc.command*10+(c-'0');
+      else
+	vt->osc.command = -1;
+      break;
+
+    case VT_ACTION_OSC_END:
+      /* handle output */
+      vt_osc_end(vt);
+      break;
+
+    case VT_ACTION_OSC_CANCEL:
+      vt_osc_cancel(vt);
+      break;
+
+    case VT_ACTION_DIGIT:
+      /* accumulate subtotal */
+      vt->arg.num.intarg = vt->arg.num.intarg*10+(c-'0');
+      break;
+
+      /* looking for 'arg;arg;...' */
+    case VT_ACTION_PARAM:
+    case VT_ACTION_FINAL:
+      if (vt->argcnt < VTPARAM_INTARGS) {
+	vt->arg.num.intargs[vt->argcnt] = vt->arg.num.intarg & 0x7fffffff;
+	vt->argcnt++;
+	vt->arg.num.intarg = 0;
       }
+      if (transition->action == VT_ACTION_FINAL)
+	vtjumps[c & 0x7f].process(vt);
       break;
-      
-      
+
       /* \E?x */
-    case 5:
+    case VT_ACTION_EXA:
+      vt->arg.num.intargs[0] = c & 0x7f;
+      break;
+
+    case VT_ACTION_EXA_END:
       vt->arg.num.intargs[1]=c;
       vt->argcnt=0;
-      modes[vt->arg.num.intargs[0]].process(vt);
-      state=0;
+      vtjumps[vt->arg.num.intargs[0]].process(vt);
+      break;
+
+    default:
+      /* ignore */
       break;
     }
+
+    state = transition->state;
   }
 
   vt->state = state;
 }
 
+/* find the class of 'width' lines, or add it if 'add' is set */
+static struct vt_line_class *
+vt_line_class(struct vt_em *vt, int width, int add)
+{
+  struct vt_line_pool *pool = &vt->pool;
+  struct vt_line_class *c;
+  int i;
+
+  /* most lines have the width of the last one */
+  if (pool->last < pool->count && pool->classes[pool->last].width == width)
+    return &pool->classes[pool->last];
+
+  for (i=0;i<pool->count;i++) {
+    if (pool->classes[i].width == width) {
+      pool->last = i;
+      return &pool->classes[i];
+    }
+  }
+
+  if (!add)
+    return NULL;
+
+  pool->classes = g_realloc(pool->classes, (pool->count+1) * sizeof(*c));
+  c = &pool->classes[pool->count];
+  c->width = width;
+  c->used = 0;
+  vt_ring_new(&c->free);
+  vt_ring_new(&c->slabs);
+  pool->last = pool->count++;
+
+  return c;
+}
+
+/**
+ * vt_line_alloc:
+ * @vt: An initialised &vt_em.
+ * @width: Width of the line, in characters.
+ *
+ * Allocates a line from the pool of @vt.  Lines of each width are
+ * carved from slabs of VT_POOL_SLAB lines, and freed lines are reused
+ * before a new slab is allocated.  Only the width is set.
+ *
+ * Return value: A line for @width characters.
+ */
+struct vt_line *
+vt_line_alloc(struct vt_em *vt, int width)
+{
+  struct vt_line_class *c;
+  struct vt_line *l;
+  char *slab;
+  int size, i;
+
+  c = vt_line_class(vt, width, 1);
+
+  if (c->free.count == 0) {
+    size = VT_LINE_SIZE(width);
+    slab = g_malloc(size * VT_POOL_SLAB);
+    vt_ring_addtail(&c->slabs, slab);
+
+    /* hand out the first line of the slab first */
+    for (i=VT_POOL_SLAB-1;i>=0;i--)
+      vt_ring_addtail(&c->free, slab + i * size);
+  }
+
+  l = (struct vt_line *)vt_ring_remtail(&c->free);
+  l->width = width;
+  c->used++;
+
+  return l;
+}
+
+/**
+ * vt_line_free:
+ * @vt: An initialised &vt_em.
+ * @l: A line from vt_line_alloc(), or NULL.
+ *
+ * Puts a line back into the pool of @vt for reuse.  Its width must
+ * not have changed since it was allocated.
+ */
+void
+vt_line_free(struct vt_em *vt, struct vt_line *l)
+{
+  struct vt_line_class *c;
+
+  if (!l)
+    return;
+
+  c = vt_line_class(vt, l->width, 0);
+  if (!c)
+    g_error("line %p of width %d is not from the pool\n", l, l->width);
+
+  vt_ring_addtail(&c->free, l);
+  c->used--;
+}
+
+static int
+vt_line_compare(const void *a, const void *b)
+{
+  const char *pa = *(void * const *)a, *pb = *(void * const *)b;
+
+  return pa < pb ? -1 : pa > pb;
+}
+
+/* release the slabs of class 'c' with none of their lines in use */
+static void
+vt_line_class_trim(struct vt_line_class *c)
+{
+  void **lines, **slabs;
+  int span, nlines, nslabs, i, j, k;
+
+  if (c->free.count < VT_POOL_SLAB)
+    return;
+
+  span = VT_LINE_SIZE(c->width) * VT_POOL_SLAB;
+  nlines = c->free.count;
+  nslabs = c->slabs.count;
+
+  /* sort the free lines and the slabs by address, so the free lines
+     of each slab are next to each other */
+  lines = g_malloc(nlines * sizeof(void *));
+  slabs = g_malloc(nslabs * sizeof(void *));
+  for (i=0;i<nlines;i++)
+    lines[i] = vt_ring_index(&c->free, i);
+  for (i=0;i<nslabs;i++)
+    slabs[i] = vt_ring_index(&c->slabs, i);
+  vt_ring_free(&c->free);
+  vt_ring_free(&c->slabs);
+  qsort(lines, nlines, sizeof(void *), vt_line_compare);
+  qsort(slabs, nslabs, sizeof(void *), vt_line_compare);
+
+  for (i=0,j=0;i<nslabs;i++) {
+    for (k=j;k<nlines && (char *)lines[k] < (char *)slabs[i] + span;k++)
+      ;
+
+    if (k - j == VT_POOL_SLAB) {
+      g_free(slabs[i]);
+    } else {
+      vt_ring_addtail(&c->slabs, slabs[i]);
+      for (;j<k;j++)
+	vt_ring_addtail(&c->free, lines[j]);
+    }
+    j = k;
+  }
+
+  g_free(lines);
+  g_free(slabs);
+}
+
+/**
+ * vt_line_trim:
+ * @vt: An initialised &vt_em.
+ *
+ * Returns the memory of the line pool that is not in use, slabs
+ * with all of their lines free, and classes with no lines left.
+ */
+void
+vt_line_trim(struct vt_em *vt)
+{
+  struct vt_line_pool *pool = &vt->pool;
+  struct vt_line_class *c;
+  int i;
+
+  for (i=0;i<pool->count;) {
+    c = &pool->classes[i];
+    vt_line_class_trim(c);
+
+    if (c->used == 0) {
+      vt_ring_free(&c->free);
+      vt_ring_free(&c->slabs);
+      pool->classes[i] = pool->classes[--pool->count];
+    } else {
+      i++;
+    }
+  }
+
+  if (pool->count == 0) {
+    g_free(pool->classes);
+    pool->classes = NULL;
+  }
+  pool->last = 0;
+}
+
+/**
+ * vt_line_pool_class:
+ * @vt: An initialised &vt_em.
+ * @index: Number of the class, from 0.
+ * @width: Returns the width of the lines of the class, or NULL.
+ * @used: Returns the number of lines of the class in use, or NULL.
+ *
+ * Reports the memory held by one class of the line pool of @vt: its
+ * slabs, including the lines that are free, and the rings tracking
+ * them.
+ *
+ * Return value: The bytes held by class @index, or 0 if there is no
+ * such class.
+ */
+size_t
+vt_line_pool_class(struct vt_em *vt, int index, int *width, int *used)
+{
+  struct vt_line_class *c;
+
+  if (index < 0 || index >= vt->pool.count)
+    return 0;
+
+  c = &vt->pool.classes[index];
+  if (width)
+    *width = c->width;
+  if (used)
+    *used = c->used;
+
+  return sizeof(*c) + (c->free.size + c->slabs.size) * sizeof(void *)
+    + (size_t)c->slabs.count * VT_POOL_SLAB * VT_LINE_SIZE(c->width);
+}
+
 /**
  * vt_newline:
  * @vt: An initialised &vt_em.
  *
- * Allocates a new line using malloc().  The line matches the
+ * Allocates a new line from the line pool.  The line matches the
  * current terminal size stored in @vt.
  *
  * Return value: A pointer to the newly allocated &vt_line structure.
  */
 struct vt_line *vt_newline(struct vt_em *vt)
 {
-  int i;
   struct vt_line *l;
 
-  l = g_malloc(VT_LINE_SIZE(vt->width));
-  l->prev = NULL;
-  l->next = NULL;
-  l->width = vt->width;
+  l = vt_line_alloc(vt, vt->width);
   l->line = -1;
   l->modcount = vt->width;
+  l->dirtystart = 0;
+  l->dirtyend = vt->width;
 
-  for (i = 0; i < vt->width; i++) {
-    l->data[i] = vt->attr & VTATTR_CLEARMASK;
-  }
+  vt_simd_fill(l->data, vt->attr & VTATTR_CLEARMASK, vt->width);
 
   return l;
 }
@@ -1753,10 +2503,14 @@ vt_init(struct vt_em *vt, int width, int height)
   struct vt_line *vl;
   int i;
 
-  vt_list_new(&vt->lines);
-  vt_list_new(&vt->lines_back);
-  vt_list_new(&vt->scrollback);
-  vt_list_new(&vt->lines_alt);
+  vt_ring_new(&vt->lines);
+  vt_ring_new(&vt->lines_back);
+  vt_ring_new(&vt->scrollback);
+  vt_ring_new(&vt->lines_alt);
+
+  vt->pool.classes = NULL;
+  vt->pool.count = 0;
+  vt->pool.last = 0;
 
   vt->width = width;
   vt->height = height;
@@ -1768,15 +2522,15 @@ vt_init(struct vt_em *vt, int width, int height)
   for (i=0;i<height;i++) {
     vl = vt_newline(vt);
     vl->line = i;
-    vt_list_addtail(&vt->lines, (struct vt_listnode *)vl);
+    vt_ring_addtail(&vt->lines, vl);
 
     vl = vt_newline(vt);
     vl->line = i;
-    vt_list_addtail(&vt->lines_back, (struct vt_listnode *)vl);
+    vt_ring_addtail(&vt->lines_back, vl);
 
     vl = vt_newline(vt);
     vl->line = i;
-    vt_list_addtail(&vt->lines_alt, (struct vt_listnode *)vl);
+    vt_ring_addtail(&vt->lines_alt, vl);
   }
   vt->cursorx=0;
   vt->cursory=0;
@@ -1785,10 +2539,12 @@ vt_init(struct vt_em *vt, int width, int height)
   vt->childpid = -1;
   vt->keyfd = -1;
 
-  memcpy(&vt->this_line, &vt->lines.head, sizeof(struct vt_line*));
+  vt->this_line = (struct vt_line *)vt_ring_index(&vt->lines, 0);
 
   vt->scrollbacklines=0;
   vt->scrollbackoffset=0;
+  vt->scrollbackunpacked=0;
+  vt->scrollbackadded=0;
   vt->scrollbackold=0;
   vt->scrollbackmax=50;		/* maximum scrollback lines */
 
@@ -1804,6 +2560,14 @@ vt_init(struct vt_em *vt, int width, int height)
 
   vt->ring_my_bell = 0L;
   vt->change_my_name = 0L;
+  vt->osc_handler = 0L;
+
+  vt->osc.buf = NULL;
+  vt->osc.len = 0;
+  vt->osc.size = 0;
+  vt->osc.command = 0;
+  vt->osc.payload = 0;
+  vt->osc.handling = VTOSC_IGNORE;
 
 #ifdef ZVT_UTF
   vt->decode.utf8.shiftchar = 0;
@@ -1950,35 +2714,46 @@ vt_destroy(struct vt_em *vt)
 
   /* clear out all scrollback memory */
   vt_scrollback_set(vt, 0);
+  vt_ring_free(&vt->scrollback);
 
   /* clear all visible lines */
-  while ( (wn = (struct vt_line *)vt_list_remhead(&vt->lines)) ) {
-    g_free(wn);
+  while ( (wn = (struct vt_line *)vt_ring_remhead(&vt->lines)) ) {
+    vt_line_free(vt, wn);
   }
+  vt_ring_free(&vt->lines);
 
   /* and all alternate lines */
-  while ( (wn = (struct vt_line *)vt_list_remhead(&vt->lines_alt)) ) {
-    g_free(wn);
+  while ( (wn = (struct vt_line *)vt_ring_remhead(&vt->lines_alt)) ) {
+    vt_line_free(vt, wn);
   }
+  vt_ring_free(&vt->lines_alt);
 
   /* and all back lines */
-  while ( (wn = (struct vt_line *)vt_list_remhead(&vt->lines_back)) ) {
-    g_free(wn);
+  while ( (wn = (struct vt_line *)vt_ring_remhead(&vt->lines_back)) ) {
+    vt_line_free(vt, wn);
   }
+  vt_ring_free(&vt->lines_back);
+
+  /* none of the lines are in use now, this releases the pool */
+  vt_line_trim(vt);
+
+  /* and the OSC buffer */
+  g_free(vt->osc.buf);
 
   /* done */
 }
 
 
 static void
-vt_resize_lines(struct vt_line *wn, int width, uint32 default_attr)
+vt_resize_lines(struct vt_em *vt, struct vt_ring *ring, int width, uint32 default_attr)
 {
-  int i;
+  int i, line;
   uint32 c;
-  struct vt_line *nn;
+  struct vt_line *wn, *nn;
+
+  for (line = 0; line < ring->count; line++) {
+    wn = (struct vt_line *)vt_ring_index(ring, line);
 
-  nn = wn->next;  
-  while (nn) {
     /* d(printf("wn->line=%d wn->width=%d width=%d\n", wn->line, wn->width, width)); */
     
     /* terminal width grew */
@@ -1989,18 +2764,20 @@ vt_resize_lines(struct vt_line *wn, int width, uint32 default_attr)
       else
 	c = default_attr;
       
-      /* resize the line */
-      wn = g_realloc(wn, VT_LINE_SIZE(width));
-      
-      /* re-link line into linked list */
-      wn->next->prev = wn;
-      wn->prev->next = wn;
+      /* resize the line, the old width is kept until it is fixed up */
+      nn = vt_line_alloc(vt, width);
+      memcpy(nn, wn, VT_LINE_SIZE(wn->width));
+      vt_line_free(vt, wn);
+      wn = nn;
+      vt_ring_set(ring, line, wn);
       
       /* if the line got bigger, fix it up */
       for (i = wn->width; i < width; i++) {
 	wn->data[i] = c;
 	wn->modcount++;
       }
+      if (width > wn->width)
+	VT_LINE_DIRTY(wn, wn->width, width);
 	
       wn->width = width;
     }
@@ -2008,17 +2785,15 @@ vt_resize_lines(struct vt_line *wn, int width, uint32 default_attr)
     /* terminal shrunk */
     if (wn->width > width) {
       /* resize the line */
-      wn = g_realloc(wn, VT_LINE_SIZE(width));
-      
-      /* re-link line into linked list */
-      wn->next->prev = wn;
-      wn->prev->next = wn;
+      nn = vt_line_alloc(vt, width);
+      memcpy(nn, wn, VT_LINE_SIZE(width));
+      vt_line_free(vt, wn);
+      wn = nn;
+      vt_ring_set(ring, line, wn);
       
       wn->width = width;
+      wn->dirtyend = MIN(wn->dirtyend, width);
     }
-    
-    wn = nn;
-    nn = nn->next;
   }
 }
 
@@ -2040,6 +2815,7 @@ void vt_resize(struct vt_em *vt, int width, int height, int pixwidth, int pixhei
   int i, count;
   uint32 c;
   struct vt_line *wn, *nn;
+  struct vt_ring *ring;
 
   vt->width = width;
 
@@ -2064,33 +2840,33 @@ void vt_resize(struct vt_em *vt, int width, int height, int pixwidth, int pixhei
        * of the terminal
        */
       if (vt->cursory==0) {
-	if ( (wn = (struct vt_line *)vt_list_remtail(&vt->lines)) )
-	  g_free(wn);
+	if ( (wn = (struct vt_line *)vt_ring_remtail(&vt->lines)) )
+	  vt_line_free(vt, wn);
 	
 	/* and for 'alternate' screen */
-	if ( (wn = (struct vt_line *)vt_list_remtail(&vt->lines_alt)) )
-	  g_free(wn);
+	if ( (wn = (struct vt_line *)vt_ring_remtail(&vt->lines_alt)) )
+	  vt_line_free(vt, wn);
 	  
 	/* repeat for backbuffer */
-	if ( (wn = (struct vt_line *)vt_list_remtail(&vt->lines_back)) )
-	  g_free(wn);
+	if ( (wn = (struct vt_line *)vt_ring_remtail(&vt->lines_back)) )
+	  vt_line_free(vt, wn);
       } else {
-	if ( (wn = (struct vt_line *)vt_list_remhead(&vt->lines)) ) {
+	if ( (wn = (struct vt_line *)vt_ring_remhead(&vt->lines)) ) {
 	  if ((vt->mode & VTMODE_ALTSCREEN)==0)
-	    vt_scrollback_add(vt, wn);
-	  g_free(wn);
+	    wn = vt_scrollback_add(vt, wn);
+	  vt_line_free(vt, wn);
 	}
 	
 	/* and for 'alternate' screen */
-	if ( (wn = (struct vt_line *)vt_list_remhead(&vt->lines_alt)) ) {
+	if ( (wn = (struct vt_line *)vt_ring_remhead(&vt->lines_alt)) ) {
 	  if ((vt->mode & VTMODE_ALTSCREEN)!=0)
-	    vt_scrollback_add(vt, wn);
-	  g_free(wn);
+	    wn = vt_scrollback_add(vt, wn);
+	  vt_line_free(vt, wn);
 	}
 	
 	/* repeat for backbuffer */
-	if ( (wn = (struct vt_line *)vt_list_remhead(&vt->lines_back)) )
-	  g_free(wn);
+	if ( (wn = (struct vt_line *)vt_ring_remhead(&vt->lines_back)) )
+	  vt_line_free(vt, wn);
 	
 	vt->cursory--;
       }
@@ -2100,12 +2876,12 @@ void vt_resize(struct vt_em *vt, int width, int height, int pixwidth, int pixhei
     /* reset the line index of now-missing lines to -1 */
     count = vt->height - height;
     if ((vt->mode & VTMODE_ALTSCREEN)==0)
-      wn = (struct vt_line *)vt->lines.tailpred;
+      ring = &vt->lines;
     else
-      wn = (struct vt_line *)vt->lines_alt.tailpred;
-    while (count && wn->prev) {
+      ring = &vt->lines_alt;
+    for (i = ring->count-1; count && i >= 0; i--) {
+      wn = (struct vt_line *)vt_ring_index(ring, i);
       wn->line = -1;
-      wn=wn->prev;
       count--;
     }
 
@@ -2143,7 +2919,9 @@ void vt_resize(struct vt_em *vt, int width, int height, int pixwidth, int pixhei
 	d(printf("removing scrollback -> top of screen\n"));
 
 	nn = vt_newline(vt);
-	wn = (struct vt_line *)vt_list_remtail(&vt->scrollback);
+	wn = (struct vt_line *)vt_ring_remtail(&vt->scrollback);
+	if (wn->line == VT_LINE_PACKED)
+	  wn = vt_line_unpack(vt, wn);
 	len = MIN(nn->width, wn->width);
 	memcpy(nn->data, wn->data, len * sizeof(uint32));
 
@@ -2154,11 +2932,11 @@ void vt_resize(struct vt_em *vt, int width, int height, int pixwidth, int pixhei
 	for (j = wn->width ; j<nn->width; j++) {
 	  nn->data[j]=c;
 	}
-	g_free(wn);
+	vt_line_free(vt, wn);
 
-	vt_list_addhead(&vt->lines, (struct vt_listnode *)nn);
-	vt_list_addhead(&vt->lines_alt, (struct vt_listnode *)vt_newline(vt));
-	vt_list_addhead(&vt->lines_back, (struct vt_listnode *)vt_newline(vt));
+	vt_ring_addhead(&vt->lines, nn);
+	vt_ring_addhead(&vt->lines_alt, vt_newline(vt));
+	vt_ring_addhead(&vt->lines_back, vt_newline(vt));
 
 	vt->scrollbacklines--;	/* since we just nuked one */
 
@@ -2170,9 +2948,9 @@ void vt_resize(struct vt_em *vt, int width, int height, int pixwidth, int pixhei
       } else {
 	d(printf("adding line to bottom of screen\n"));
 	/* otherwise just add blank lines to the bottom */
-	vt_list_addtail(&vt->lines, (struct vt_listnode *)vt_newline(vt));
-	vt_list_addtail(&vt->lines_back, (struct vt_listnode *)vt_newline(vt));
-	vt_list_addtail(&vt->lines_alt, (struct vt_listnode *)vt_newline(vt));
+	vt_ring_addtail(&vt->lines, vt_newline(vt));
+	vt_ring_addtail(&vt->lines_back, vt_newline(vt));
+	vt_ring_addtail(&vt->lines_alt, vt_newline(vt));
       } /* if scrollbacklines */
     }
   } /* otherwise width may have changed? */
@@ -2188,12 +2966,15 @@ void vt_resize(struct vt_em *vt, int width, int height, int pixwidth, int pixhei
   /* now, scan all lines visible, and make them the right width
    * for all 3 'buffers', onscreen, offscreen and alternate
    */
-  vt_resize_lines((struct vt_line *) vt->lines.head, width, vt->attr & VTATTR_CLEARMASK);
-  vt_resize_lines((struct vt_line *) vt->lines_back.head, width, vt->attr & VTATTR_CLEARMASK);
-  vt_resize_lines((struct vt_line *) vt->lines_alt.head, width, vt->attr & VTATTR_CLEARMASK);
+  vt_resize_lines(vt, &vt->lines, width, vt->attr & VTATTR_CLEARMASK);
+  vt_resize_lines(vt, &vt->lines_back, width, vt->attr & VTATTR_CLEARMASK);
+  vt_resize_lines(vt, &vt->lines_alt, width, vt->attr & VTATTR_CLEARMASK);
+
+  /* lines of the old width may have gone, release their memory */
+  vt_line_trim(vt);
 
   /* re-fix 'this line' pointer */
-  vt->this_line = (struct vt_line *) vt_list_index(&vt->lines, vt->cursory);
+  vt->this_line = (struct vt_line *) vt_ring_index(&vt->lines, vt->cursory);
   n(vt->this_line);
   zvt_resize_subshell(vt->childfd, width, height, pixwidth, pixheight);
 
@@ -2203,9 +2984,9 @@ void vt_resize(struct vt_em *vt, int width, int height, int pixwidth, int pixhei
     printf("line\talt\tback\n");
     for (i=0;i<height;i++) {
       printf("%d\t%d\t%d\n",
-	     ((struct vt_line *)vt_list_index(&vt->lines, i))->line,
-	     ((struct vt_line *)vt_list_index(&vt->lines_alt, i))->line,
-	     ((struct vt_line *)vt_list_index(&vt->lines_back, i))->line);
+	     ((struct vt_line *)vt_ring_index(&vt->lines, i))->line,
+	     ((struct vt_line *)vt_ring_index(&vt->lines_alt, i))->line,
+	     ((struct vt_line *)vt_ring_index(&vt->lines_back, i))->line);
     }
   }
 #endif
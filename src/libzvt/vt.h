@@ -29,6 +29,9 @@
 /* for utf-8 input support */
 #define ZVT_UTF 1
 
+/* screen and scrollback lines are kept in rings, see vt_view_line() */
+#define ZVT_LINE_RING 1
+
 #ifdef __cplusplus
 extern "C" {
 #endif /* __cplusplus */
@@ -45,19 +48,52 @@ typedef unsigned int uint32;
 #define VTPARAM_MAXARGS   5	/* maximum number of arguments */
 #define VTPARAM_ARGMAX   20	/* number of characters in each arg maximum */
 #define VTPARAM_INTARGS  20	/* maximum args for integers, should be less than MAXARGS*ARGMAX bytes! */
+#define VTPARAM_OSCMAX 65536	/* maximum length of a buffered OSC string, longer ones are truncated */
 
 struct vt_line {
-  struct vt_line *next;		/* next 'vt' line */
-  struct vt_line *prev;		/* prev 'vt' line */
   int line;			/* the line number for this line */
   int width;			/* width of this line */
   int modcount;			/* how many modifications since last update */
+  int dirtystart, dirtyend;	/* columns modified since last drawn, none if start >= end */
   uint32 data[1];		/* the line data follows this structure */
 };
 
 /* macro for computing the size of vt_line structures */
 #define VT_LINE_SIZE(width) (sizeof(struct vt_line) + (sizeof(uint32) * (width)))
 
+/* macros for tracking the modified columns of a line.  vt_update()
+   only redraws those, a renderer working from copies of the screen
+   only copies the lines with some.  either marks them clean after */
+#define VT_LINE_DIRTY(l, start, end) do {		\
+    if ((start) < (l)->dirtystart)			\
+      (l)->dirtystart = (start);			\
+    if ((end) > (l)->dirtyend)				\
+      (l)->dirtyend = (end);				\
+  } while (0)
+#define VT_LINE_CLEAN(l) ((l)->dirtystart = (l)->width, (l)->dirtyend = 0)
+
+/* line number of a packed scrollback line, its width is the number of
+   data words then.  vt_view_line() only returns unpacked lines */
+#define VT_LINE_PACKED (-2)
+
+/* lines are allocated from slabs of this many lines of the same width */
+#define VT_POOL_SLAB 32
+
+/* lines of one width, see vt_line_alloc() */
+struct vt_line_class {
+  int width;			/* width of the lines in this class */
+  int used;			/* lines handed out */
+  struct vt_ring free;		/* lines ready for reuse */
+  struct vt_ring slabs;		/* blocks of VT_POOL_SLAB lines */
+};
+
+/* per terminal allocator for the lines, a class per width in use */
+struct vt_line_pool {
+  struct vt_line_class *classes;
+  int count;
+  int last;			/* class of the last allocation */
+};
+
 /* type of title to set with callback */
 typedef enum {
   VTTITLE_WINDOWICON=0,		/* set both window title and icon name */
@@ -66,6 +102,17 @@ typedef enum {
   VTTITLE_XPROPERTY		/* set X property */
 } VTTITLE_TYPE;
 
+/* events of an OSC string, passed to the osc_handler callback */
+#define VTOSC_START  0		/* command number parsed, return how to pass the payload */
+#define VTOSC_DATA   1		/* next piece of a streamed payload */
+#define VTOSC_END    2		/* string terminated, with the payload if it was buffered */
+#define VTOSC_CANCEL 3		/* string aborted by a line feed or another escape sequence */
+
+/* return values of the osc_handler callback for VTOSC_START */
+#define VTOSC_IGNORE 0		/* not handled, titles are set through change_my_name */
+#define VTOSC_STREAM 1		/* pass the payload in pieces, as it arrives */
+#define VTOSC_BUFFER 2		/* collect the payload and pass it at the end */
+
 /* note: bit 0x80000000 is free for another attribute */
 #define VTATTR_BOLD       0x40000000
 #define VTATTR_UNDERLINE  0x20000000
@@ -136,23 +183,37 @@ struct vt_em {
 
   int argcnt;
 
+  struct {
+    char *buf;			/* buffered payload, kept for the next string */
+    int len;			/* bytes in buf */
+    int size;			/* bytes allocated for buf */
+    int command;		/* OSC number, -1 if it is not a number */
+    int payload;		/* ';' seen, the rest is payload */
+    int handling;		/* VTOSC_* returned by osc_handler */
+  } osc;
+
   int state;			/* current parse state */
 
   struct vt_line *this_line;	/* the current line */
 
-  struct vt_list lines;		/* double linked list of lines */
-  struct vt_list lines_back;	/* 'last rendered' buffer.  used to optimise updates */
-  struct vt_list lines_alt;	/* alternate screen */
+  struct vt_ring lines;		/* lines of the screen, indexed by row */
+  struct vt_ring lines_back;	/* 'last rendered' buffer.  used to optimise updates */
+  struct vt_ring lines_alt;	/* alternate screen */
+
+  struct vt_line_pool pool;	/* all of the lines come from here */
 
   /* scroll back stuff */
-  struct vt_list scrollback;	/* double linked list of scrollback lines */
+  struct vt_ring scrollback;	/* scrollback lines, oldest first */
   int scrollbacklines;		/* total scroll back lines */
   int scrollbackoffset;		/* viewing offset */
   int scrollbackold;		/* old scrollback offset */
   int scrollbackmax;		/* maximum scrollbacklines, after this total is reached,
 				   old lines are discarded */
+  int scrollbackunpacked;	/* lines unpacked to be looked at, see vt_scrollback_pack() */
+  int scrollbackadded;		/* lines added since vt_scrollback_pack() */
   void (*ring_my_bell)(void *user_data);	/* ring my bell ... */
   void (*change_my_name)(void *user_data, char *name, VTTITLE_TYPE type);	/* ring my bell ... */
+  int (*osc_handler)(void *user_data, int command, int event, const char *data, int len); /* OSC strings */
 
   void *user_data;		/* opaque external data handle for callbacks */
 
@@ -205,10 +266,23 @@ int   	      vt_writechild     (struct vt_em *vt, char *buffer, int len);
 int   	      vt_report_button  (struct vt_em *vt, int down, int button, int qual,
 			         int x, int y);
 void  	      vt_scrollback_set (struct vt_em *vt, int lines);
+void  	      vt_scrollback_pack(struct vt_em *vt);
 int   	      vt_killchild      (struct vt_em *vt, int signal);
 int   	      vt_closepty       (struct vt_em *vt);
 void	      vt_reset_terminal (struct vt_em *vt, int hard);
 
+struct vt_line *vt_line_alloc   (struct vt_em *vt, int width);
+void            vt_line_free    (struct vt_em *vt, struct vt_line *l);
+void            vt_line_trim    (struct vt_em *vt);
+size_t          vt_line_pool_class(struct vt_em *vt, int index, int *width, int *used);
+
+/* lines by view index: 0 is the top of the screen, negative indices
+   are the scrollback, -1 being its last line.  next/prev step from
+   line l at view index 'index', they return NULL past either end */
+struct vt_line *vt_view_line    (struct vt_em *vt, int index);
+struct vt_line *vt_view_next    (struct vt_em *vt, struct vt_line *l, int index);
+struct vt_line *vt_view_prev    (struct vt_em *vt, struct vt_line *l, int index);
+
 #ifdef __cplusplus
 	   }
 #endif /* __cplusplus */
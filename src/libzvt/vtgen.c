@@ -0,0 +1,211 @@
+/*  vtgen.c - Zed's Virtual Terminal
+ *
+ *  Generates the transition table of vt_parse_vt() from vtjumps.def.
+ *  Bytes that behave the same in every state share a class, the table
+ *  gives the action and the next state for each state and class.
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Library General Public License
+ *  as published by the Free Software Foundation; either version 2 of
+ *  the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Library General Public
+ *  License along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "vtparse.h"
+
+static const int vtmodes[128] = {
+#define VT_JUMP(process, modes) modes
+#include "vtjumps.def"
+#undef VT_JUMP
+};
+
+/* bytes, then characters decoded from utf-8, which are always literals:
+   the ascii ones (overlong sequences) and all others */
+#define DECODED 256
+#define COLUMNS (DECODED + 129)
+
+static struct vt_transition table[VT_STATES][COLUMNS];
+
+static struct vt_transition
+transition(int action, int state)
+{
+  struct vt_transition t;
+
+  t.action = action;
+  t.state = state;
+
+  return t;
+}
+
+/* must match the semantics of the actions in vt_parse_vt() */
+static struct vt_transition
+simulate(int state, int c, int mode)
+{
+  switch (state) {
+  case 0:
+    if (mode & VT_LIT)
+      return transition(VT_ACTION_PRINT, 0);
+    if (mode & VT_CON)
+      return transition(VT_ACTION_PROCESS, 0);
+    if (c==27)
+      return transition(VT_ACTION_NONE, 1);
+    return transition(VT_ACTION_NONE, 0);
+
+  case 1:
+    if (mode & VT_ESC)
+      return transition(VT_ACTION_ESCAPE, 0);
+    if (c=='[')
+      return transition(VT_ACTION_CSI, 2);
+    if (c=='O')
+      return transition(VT_ACTION_NONE, 3);
+    if (c==']')
+      return transition(VT_ACTION_OSC, 4);
+    if (mode & VT_EXA)
+      return transition(VT_ACTION_EXA, 5);
+    return transition(VT_ACTION_NONE, 0);
+
+  case 2:
+    if (c=='?')
+      return transition(VT_ACTION_NONE, 6);
+    if (c=='>')
+      return transition(VT_ACTION_NONE, 10);
+    if (c=='!')
+      return transition(VT_ACTION_NONE, 8);
+    /* fall through */
+  case 6:
+  case 7:
+  case 8:
+  case 9:
+  case 10:
+    if (mode & VT_ARG)
+      return transition(VT_ACTION_DIGIT, state);
+    if (mode & VT_EXB)
+      return transition(VT_ACTION_FINAL, 0);
+    if (c==';' || c==':')
+      return transition(VT_ACTION_PARAM, state);
+    if (mode & VT_CON)
+      return transition(VT_ACTION_PROCESS, state);
+    if (c==' ')
+      return transition(VT_ACTION_NONE, 7);
+    if (c=='\'')
+      return transition(VT_ACTION_NONE, 9);
+    return transition(VT_ACTION_NONE, 0);
+
+  case 3:
+    if (mode & VT_EXO)
+      return transition(VT_ACTION_SS3, 0);
+    return transition(VT_ACTION_NONE, 0);
+
+  case 4:
+    if (c==0x07)
+      return transition(VT_ACTION_OSC_END, 0);
+    if (c==0x0a)
+      return transition(VT_ACTION_OSC_CANCEL, 0);
+    if (c==27)
+      return transition(VT_ACTION_NONE, 11);
+    return transition(VT_ACTION_OSC_CHAR, 4);
+
+  case 11:
+    /* ST ends the text, any other escape sequence cancels it */
+    if (c=='\\')
+      return transition(VT_ACTION_OSC_END, 0);
+    return simulate(1, c, mode);
+
+  case 5:
+  default:
+    return transition(VT_ACTION_EXA_END, 0);
+  }
+}
+
+static int
+same_column(int a, int b)
+{
+  int state;
+
+  for (state = 0; state < VT_STATES; state++)
+    if (memcmp(&table[state][a], &table[state][b], sizeof(struct vt_transition)))
+      return 0;
+
+  return 1;
+}
+
+int
+main(int argc, char **argv)
+{
+  FILE *f;
+  int state, c, i, classes = 0;
+  int column_class[COLUMNS];
+  int class_column[COLUMNS];
+
+  for (state = 0; state < VT_STATES; state++) {
+    for (c = 0; c < 256; c++)
+      table[state][c] = simulate(state, c, vtmodes[c & 0x7f]);
+
+    for (c = 0; c <= 0x80; c++)
+      table[state][DECODED + c] = simulate(state, c, VT_LIT);
+  }
+
+  /* merge identical columns into classes */
+  for (c = 0; c < COLUMNS; c++) {
+    for (i = 0; i < classes; i++)
+      if (same_column(c, class_column[i]))
+	break;
+
+    if (i == classes)
+      class_column[classes++] = c;
+
+    column_class[c] = i;
+  }
+
+  if (argc > 1) {
+    f = fopen(argv[1], "w");
+    if (!f) {
+      perror(argv[1]);
+      return 1;
+    }
+  } else
+    f = stdout;
+
+  fprintf(f, "/* Generated by vtgen from vtjumps.def, do not edit */\n\n");
+  fprintf(f, "#define VT_CLASSES %d\n", classes);
+  fprintf(f, "#define VT_CLASS_DECODED %d\n\n", column_class[DECODED + 0x80]);
+
+  fprintf(f, "static const unsigned char vt_byte_class[256] = {");
+  for (c = 0; c < 256; c++)
+    fprintf(f, "%s%2d,", c % 16 ? " " : "\n  ", column_class[c]);
+  fprintf(f, "\n};\n\n");
+
+  fprintf(f, "/* classes of the ascii characters decoded from overlong utf-8 sequences */\n");
+  fprintf(f, "static const unsigned char vt_decoded_class[128] = {");
+  for (c = 0; c < 128; c++)
+    fprintf(f, "%s%2d,", c % 16 ? " " : "\n  ", column_class[DECODED + c]);
+  fprintf(f, "\n};\n\n");
+
+  fprintf(f, "static const struct vt_transition vt_transitions[VT_STATES][VT_CLASSES] = {\n");
+  for (state = 0; state < VT_STATES; state++) {
+    fprintf(f, "  {");
+    for (i = 0; i < classes; i++)
+      fprintf(f, "%s{%d,%d},", i % 8 ? " " : "\n    ",
+	      table[state][class_column[i]].action, table[state][class_column[i]].state);
+    fprintf(f, "\n  },\n");
+  }
+  fprintf(f, "};\n");
+
+  if (f != stdout && fclose(f)) {
+    perror(argv[1]);
+    return 1;
+  }
+
+  return 0;
+}
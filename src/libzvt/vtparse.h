@@ -0,0 +1,64 @@
+/*  vtparse.h - Zed's Virtual Terminal
+ *
+ *  Parser transition table definitions, shared by vt.c and the
+ *  vtgen table generator.
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Library General Public License
+ *  as published by the Free Software Foundation; either version 2 of
+ *  the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Library General Public
+ *  License along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+#ifndef _ZVT_VTPARSE_H_
+#define _ZVT_VTPARSE_H_
+
+/* modes of the vtjumps entries, see vtjumps.def */
+#define VT_LIT 0x01		/* literal */
+#define VT_CON 0x02		/* control character */
+#define VT_EXB 0x04		/* escape [ sequence */
+#define VT_EXO 0x08		/* escape O sequence */
+#define VT_ESC 0x10		/* escape "x" sequence */
+#define VT_ARG 0x20		/* character is a possible argument to function (only digits!) */
+#define VT_EXA 0x40		/* escape x "x" sequence */
+
+#define VT_EBL (VT_EXB|VT_LIT)	/* escape [ or literal */
+#define VT_EXL (VT_ESC|VT_LIT)	/* escape "x" or literal */
+#define VT_BOL (VT_EBL|VT_EXO)	/* escape [, escape O, or literal */
+
+/* number of parser states, see vt_parse_vt() */
+#define VT_STATES 12
+
+/* what to do with a character, before moving to the next state */
+enum {
+  VT_ACTION_NONE,		/* ignore */
+  VT_ACTION_PRINT,		/* output a literal */
+  VT_ACTION_PROCESS,		/* run the process function */
+  VT_ACTION_ESCAPE,		/* \Ex, run the process function without arguments */
+  VT_ACTION_CSI,		/* \E[, reset the arguments */
+  VT_ACTION_SS3,		/* \EOx, run the process function without arguments */
+  VT_ACTION_OSC,		/* \E], start the text argument */
+  VT_ACTION_OSC_CHAR,		/* add to the text argument */
+  VT_ACTION_OSC_END,		/* set text */
+  VT_ACTION_OSC_CANCEL,		/* drop the text argument */
+  VT_ACTION_DIGIT,		/* accumulate a numeric argument */
+  VT_ACTION_PARAM,		/* end a numeric argument */
+  VT_ACTION_FINAL,		/* end a numeric argument and run the process function */
+  VT_ACTION_EXA,		/* \Exy, remember x */
+  VT_ACTION_EXA_END		/* \Exy, run the process function of x */
+};
+
+struct vt_transition {
+  unsigned char action;
+  unsigned char state;
+};
+
+#endif /* _ZVT_VTPARSE_H_ */
@@ -0,0 +1,214 @@
+/*
+   This file is part of DFBTerm.
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along
+   with this program; if not, write to the Free Software Foundation, Inc.,
+   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include <term-clipboard.h>
+
+/**********************************************************************************************************************/
+
+#define B64_INVALID  -1
+#define B64_PAD      -2
+
+typedef enum {
+     CLIPBOARD_SELECTIONS,    /* before the ';' */
+     CLIPBOARD_DATA,          /* base64 data */
+     CLIPBOARD_PADDING,       /* '=' seen, only more of it may follow */
+     CLIPBOARD_DROPPED        /* query, invalid or too large */
+} ClipboardState;
+
+struct _TermClipboard {
+     ClipboardState  state;
+     unsigned int    bits;    /* decoded bits not yet stored */
+     int             nbits;
+
+     char           *buffer;
+     size_t          size;
+     size_t          allocated;
+     size_t          max_size;
+};
+
+static signed char b64_values[256];
+static int         b64_ready;
+
+static void b64_init()
+{
+     static const char alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+     int               i;
+
+     memset( b64_values, B64_INVALID, sizeof(b64_values) );
+
+     for (i = 0; i < 64; i++)
+          b64_values[(unsigned char) alphabet[i]] = i;
+
+     b64_values['='] = B64_PAD;
+
+     b64_ready = 1;
+}
+
+/* Makes room for count more decoded bytes, drops the data if it gets too large */
+static int clipboard_reserve( TermClipboard *clipboard, size_t count )
+{
+     size_t  allocated;
+     char   *buffer;
+
+     if (clipboard->size + count <= clipboard->allocated)
+          return 1;
+
+     if (clipboard->size + count > clipboard->max_size) {
+          clipboard->state = CLIPBOARD_DROPPED;
+          return 0;
+     }
+
+     allocated = clipboard->allocated ? clipboard->allocated : 4096;
+
+     while (allocated < clipboard->size + count)
+          allocated *= 2;
+
+     if (allocated > clipboard->max_size)
+          allocated = clipboard->max_size;
+
+     buffer = realloc( clipboard->buffer, allocated );
+     if (!buffer) {
+          clipboard->state = CLIPBOARD_DROPPED;
+          return 0;
+     }
+
+     clipboard->buffer    = buffer;
+     clipboard->allocated = allocated;
+
+     return 1;
+}
+
+/**********************************************************************************************************************/
+
+TermClipboard *term_clipboard_create( size_t max_size )
+{
+     TermClipboard *clipboard;
+
+     clipboard = calloc( 1, sizeof(TermClipboard) );
+     if (!clipboard)
+          return NULL;
+
+     clipboard->max_size = max_size;
+
+     if (!b64_ready)
+          b64_init();
+
+     return clipboard;
+}
+
+void term_clipboard_begin( TermClipboard *clipboard )
+{
+     clipboard->state = CLIPBOARD_SELECTIONS;
+     clipboard->bits  = 0;
+     clipboard->nbits = 0;
+     clipboard->size  = 0;
+
+     /* Do not hold on to the memory of a large previous string */
+     if (clipboard->allocated > 4096) {
+          free( clipboard->buffer );
+
+          clipboard->buffer    = NULL;
+          clipboard->allocated = 0;
+     }
+}
+
+void term_clipboard_write( TermClipboard *clipboard, const char *data, size_t count )
+{
+     const unsigned char *p   = (const unsigned char*) data;
+     const unsigned char *end = p + count;
+     const unsigned char *pad;
+     unsigned int         bits;
+     int                  nbits;
+     char                *out;
+
+     if (clipboard->state == CLIPBOARD_SELECTIONS) {
+          const unsigned char *sep = memchr( p, ';', count );
+
+          if (!sep)
+               return;
+
+          clipboard->state = CLIPBOARD_DATA;
+
+          p = sep + 1;
+
+          /* Reading the clipboard is not supported */
+          if (p < end && *p == '?')
+               clipboard->state = CLIPBOARD_DROPPED;
+     }
+
+     /* Every character up to the padding gives six bits */
+     pad = clipboard->state == CLIPBOARD_DATA ? memchr( p, '=', end - p ) : NULL;
+
+     if (clipboard->state == CLIPBOARD_DATA &&
+         clipboard_reserve( clipboard, (clipboard->nbits + 6 * ((pad ? pad : end) - p)) / 8 )) {
+          bits  = clipboard->bits;
+          nbits = clipboard->nbits;
+          out   = clipboard->buffer + clipboard->size;
+
+          while (p < end) {
+               int value = b64_values[*p++];
+
+               if (value < 0) {
+                    clipboard->state = value == B64_PAD ? CLIPBOARD_PADDING : CLIPBOARD_DROPPED;
+                    break;
+               }
+
+               bits   = (bits << 6) | value;
+               nbits += 6;
+
+               if (nbits >= 8) {
+                    nbits -= 8;
+                    *out++ = bits >> nbits;
+               }
+          }
+
+          clipboard->bits  = bits & ((1 << nbits) - 1);
+          clipboard->nbits = nbits;
+          clipboard->size  = out - clipboard->buffer;
+     }
+
+     /* Padding may only be followed by more padding */
+     while (clipboard->state == CLIPBOARD_PADDING && p < end) {
+          if (*p++ != '=')
+               clipboard->state = CLIPBOARD_DROPPED;
+     }
+}
+
+const char *term_clipboard_end( TermClipboard *clipboard, size_t *size )
+{
+     if (clipboard->state != CLIPBOARD_DATA && clipboard->state != CLIPBOARD_PADDING)
+          return NULL;
+
+     if (!clipboard->size)
+          return NULL;
+
+     *size = clipboard->size;
+
+     return clipboard->buffer;
+}
+
+void term_clipboard_destroy( TermClipboard *clipboard )
+{
+     if (!clipboard)
+          return;
+
+     free( clipboard->buffer );
+     free( clipboard );
+}
@@ -0,0 +1,45 @@
+/*
+   This file is part of DFBTerm.
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along
+   with this program; if not, write to the Free Software Foundation, Inc.,
+   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA
+*/
+
+#ifndef __TERM_CLIPBOARD_H__
+#define __TERM_CLIPBOARD_H__
+
+#include <stddef.h>
+
+/*
+ * Decoder for the payload of OSC 52 strings, "<selections>;<base64 data>", which is fed in pieces as it arrives.
+ * The data is decoded on the fly and at most max_size decoded bytes are kept, longer data is dropped as a whole.
+ */
+
+#define TERM_CLIPBOARD_DEFAULT_SIZE  (4 * 1024 * 1024)
+
+typedef struct _TermClipboard TermClipboard;
+
+TermClipboard *term_clipboard_create ( size_t max_size );
+
+void           term_clipboard_begin  ( TermClipboard *clipboard );
+
+void           term_clipboard_write  ( TermClipboard *clipboard, const char *data, size_t count );
+
+/* Returns the decoded data of the complete string, or NULL if it was empty, a query, not valid or too large.
+   The data is valid until the next string begins. */
+const char    *term_clipboard_end    ( TermClipboard *clipboard, size_t *size );
+
+void           term_clipboard_destroy( TermClipboard *clipboard );
+
+#endif
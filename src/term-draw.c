@@ -0,0 +1,376 @@
+/*
+   This file is part of DFBTerm.
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along
+   with this program; if not, write to the Free Software Foundation, Inc.,
+   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include <term.h>
+
+/**********************************************************************************************************************/
+
+static void add_flip( Term *term, DFBRegion *region )
+{
+     if (term->flip_pending) {
+          if (term->flip_region.x1 > region->x1)
+               term->flip_region.x1 = region->x1;
+
+          if (term->flip_region.y1 > region->y1)
+               term->flip_region.y1 = region->y1;
+
+          if (term->flip_region.x2 < region->x2)
+               term->flip_region.x2 = region->x2;
+
+          if (term->flip_region.y2 < region->y2)
+               term->flip_region.y2 = region->y2;
+     }
+     else {
+          term->flip_region  = *region;
+          term->flip_pending = DFB_TRUE;
+     }
+}
+
+#ifdef USE_LIBTSM
+
+static void draw_cell( Term *term, const TermCell *cell, int posx, int posy )
+{
+     DFBRegion  region;
+     int        i, x, y, fga, bga;
+     u8         fr, fg, fb, br, bg, bb;
+
+     term->hud_draws++;
+
+     fr = cell->fr;
+     fg = cell->fg;
+     fb = cell->fb;
+     br = cell->br;
+     bg = cell->bg;
+     bb = cell->bb;
+
+     if (cell->inverse) {
+          i = fr; fr = br; br = i;
+          i = fg; fg = bg; bg = i;
+          i = fb; fb = bb; bb = i;
+
+          fga  = TERM_BGALPHA;
+          bga  = 0xff;
+     }
+     else {
+          fga  = 0xff;
+          bga  = TERM_BGALPHA;
+     }
+
+     x = posx * term->CW;
+     y = posy * term->CH;
+
+     region.x1 = x;
+     region.y1 = y;
+     region.x2 = x + cell->width * term->CW - 1;
+     region.y2 = y + term->CH - 1;
+
+     term->surface->SetColor( term->surface, br, bg, bb, bga );
+
+     term->surface->FillRectangle( term->surface, x, y, term->CW * cell->width, term->CH );
+
+     if (cell->ch) {
+          term->surface->SetColor( term->surface, fr, fg, fb, fga );
+
+          term->surface->DrawGlyph( term->surface, cell->ch, x, y, DSTF_TOPLEFT );
+     }
+
+     if (!term->in_resize)
+          add_flip( term, &region );
+}
+
+/* Draws the changed cells of a row */
+static void draw_row( Term *term, const TermCell *cells, TermCell *shown, int posy, int cols )
+{
+     int i;
+
+     for (i = 0; i < cols; i++) {
+          if (!memcmp( &cells[i], &shown[i], sizeof(TermCell) ))
+               continue;
+
+          if (cells[i].width)
+               draw_cell( term, &cells[i], i, posy );
+
+          shown[i] = cells[i];
+     }
+}
+
+#else
+
+/* The first 16 values are the ANSI colors, the last two are the default foreground and default background */
+
+const u8 default_red[18] = {
+     0x00, 0xaa, 0x00, 0xaa, 0x00, 0xaa, 0x00, 0xbb, 0x77, 0xff, 0x55, 0xff, 0x55, 0xff, 0x55, 0xff, 0xb0, 0x00
+};
+
+const u8 default_grn[18] = {
+     0x00, 0x00, 0xaa, 0x55, 0x00, 0x00, 0xaa, 0xbb, 0x77, 0x55, 0xff, 0xff, 0x55, 0x55, 0xff, 0xff, 0xb0, 0x00
+};
+
+const u8 default_blu[18] = {
+     0x00, 0x00, 0x00, 0x00, 0xaa, 0xaa, 0xaa, 0xbb, 0x77, 0x55, 0x55, 0x55, 0xff, 0xff, 0xff, 0xff, 0xb0, 0x00
+};
+
+static int unichar_to_utf8( unsigned int c, char *s )
+{
+     int len = 0;
+     int first;
+     int i;
+
+     if (c < 0x80) {
+          first = 0;
+          len = 1;
+     }
+     else if (c < 0x800) {
+          first = 0xc0;
+          len = 2;
+     }
+     else if (c < 0x10000) {
+          first = 0xe0;
+          len = 3;
+     }
+     else if (c < 0x200000) {
+          first = 0xf0;
+          len = 4;
+     }
+     else if (c < 0x4000000) {
+          first = 0xf8;
+          len = 5;
+     }
+     else {
+          first = 0xfc;
+          len = 6;
+     }
+
+     if (s) {
+          for (i = len - 1; i > 0; --i) {
+               s[i] = (c & 0x3f) | 0x80;
+               c >>= 6;
+          }
+
+          s[0] = c | first;
+     }
+
+     return len;
+}
+
+static void draw_text( Term *term, const TermCell *cells, int posy, int posx, int len )
+{
+     DFBRegion  region;
+     int        i, n, x, y, fore, back, fga, bga;
+     char       text[len*6]; /* enough memory space for UTF-8 worst case */
+     int        attr = cells[0] & VTATTR_MASK;
+
+     term->hud_draws++;
+
+     fore = (attr & VTATTR_FORECOLOURM) >> VTATTR_FORECOLOURB;
+     back = (attr & VTATTR_BACKCOLOURM) >> VTATTR_BACKCOLOURB;
+
+     if ((attr & VTATTR_BOLD) && fore < 8)
+          fore |= 8;
+
+     if (attr & VTATTR_REVERSE) {
+          i    = fore;
+          fore = back;
+          back = i;
+
+          fga  = TERM_BGALPHA;
+          bga  = 0xff;
+     }
+     else {
+          fga  = 0xff;
+          bga  = TERM_BGALPHA;
+     }
+
+     x = posx * term->CW;
+     y = posy * term->CH;
+
+     region.x1 = x;
+     region.y1 = y;
+     region.x2 = x + len * term->CW - 1;
+     region.y2 = y + term->CH - 1;
+
+     term->surface->SetColor( term->surface, default_red[back], default_grn[back], default_blu[back], bga );
+
+     term->surface->FillRectangle( term->surface, x, y, term->CW * len, term->CH );
+
+     term->surface->SetColor( term->surface, default_red[fore], default_grn[fore], default_blu[fore], fga );
+
+     for (i = 0, n = 0; i < len; i++) {
+          unsigned int c;
+
+          c = VT_ASCII( cells[i] );
+
+          if (c < 128)
+               text[n++] = c;
+          else
+               n += unichar_to_utf8( c, text + n );
+     }
+
+     term->surface->DrawString( term->surface, text, n, x, y, DSTF_TOPLEFT );
+
+     if (!term->in_resize)
+          add_flip( term, &region );
+}
+
+/* Draws the changed cells of a row, in runs of the same attributes */
+static void draw_row( Term *term, const TermCell *cells, TermCell *shown, int posy, int cols )
+{
+     int i, start;
+
+     for (i = 0; i < cols; ) {
+          if (cells[i] == shown[i]) {
+               i++;
+               continue;
+          }
+
+          start = i++;
+
+          while (i < cols && cells[i] != shown[i] && (cells[i] & VTATTR_MASK) == (cells[start] & VTATTR_MASK))
+               i++;
+
+          draw_text( term, cells + start, posy, start, i - start );
+
+          memcpy( shown + start, cells + start, (i - start) * sizeof(TermCell) );
+     }
+}
+
+#endif
+
+static void draw_scroll( Term *term, int firstrow, int count, int offset )
+{
+     DFBRegion     region;
+     DFBRectangle  rect;
+
+     term->hud_draws++;
+
+     rect.x = 0;
+     rect.y = (firstrow + offset) * term->CH;
+     rect.w = term->width;
+     rect.h = count * term->CH;
+
+     term->surface->Blit( term->surface, term->surface, &rect, 0, firstrow * term->CH );
+
+     region.x1 = 0;
+     region.x2 = term->width - 1;
+     region.y1 = firstrow * term->CH;
+     region.y2 = region.y1 + count * term->CH - 1;
+
+     if (!term->in_resize)
+          add_flip( term, &region );
+}
+
+/*
+ * Returns by how many rows the shown content has to be moved up (or down if negative) to match most of the new
+ * snapshot, or 0 if blitting would not save redrawing more than half of the screen.  Only the rows that the first
+ * changed rows may have come from are tried.
+ */
+static int find_scroll( Term *term, const unsigned long long *ids, int rows )
+{
+     int i, j, r, d, tried, matches;
+     int best         = 0;
+     int best_matches = 0;
+
+     for (i = 0; i < rows; i++)
+          if (ids[i] == term->shown_ids[i])
+               best_matches++;
+
+     for (r = 0, tried = 0; r < rows && tried < 4; r++) {
+          if (ids[r] == term->shown_ids[r])
+               continue;
+
+          tried++;
+
+          for (j = 0; j < rows; j++) {
+               if (j == r || term->shown_ids[j] != ids[r])
+                    continue;
+
+               d = j - r;
+
+               for (i = MAX( 0, -d ), matches = 0; i < rows && i + d < rows; i++)
+                    if (ids[i] == term->shown_ids[i+d])
+                         matches++;
+
+               if (matches > best_matches) {
+                    best         = d;
+                    best_matches = matches;
+               }
+          }
+     }
+
+     return best_matches > rows / 2 ? best : 0;
+}
+
+void term_draw_invalidate( Term *term )
+{
+     term->shown_cols = 0;
+     term->shown_rows = 0;
+}
+
+void term_draw_snapshot( Term *term, const TermSnapshot *snapshot )
+{
+     int row, scroll;
+     int cols = snapshot->cols;
+     int rows = snapshot->rows;
+
+     if (cols != term->shown_cols || rows != term->shown_rows) {
+          TermCell           *shown     = realloc( term->shown, cols * rows * sizeof(TermCell) );
+          unsigned long long *shown_ids = realloc( term->shown_ids, rows * sizeof(unsigned long long) );
+
+          if (shown)
+               term->shown = shown;
+
+          if (shown_ids)
+               term->shown_ids = shown_ids;
+
+          if (!shown || !shown_ids) {
+               term_draw_invalidate( term );
+               return;
+          }
+
+          /* Nothing is known about what is shown, every cell is drawn */
+          term->shown_cols = cols;
+          term->shown_rows = rows;
+
+          memset( term->shown, 0xff, cols * rows * sizeof(TermCell) );
+          memset( term->shown_ids, 0, rows * sizeof(unsigned long long) );
+     }
+     else if ((scroll = find_scroll( term, snapshot->ids, rows )) > 0) {
+          draw_scroll( term, 0, rows - scroll, scroll );
+
+          memmove( term->shown, term->shown + scroll * cols, (rows - scroll) * cols * sizeof(TermCell) );
+          memmove( term->shown_ids, term->shown_ids + scroll, (rows - scroll) * sizeof(unsigned long long) );
+     }
+     else if (scroll < 0) {
+          draw_scroll( term, -scroll, rows + scroll, scroll );
+
+          memmove( term->shown - scroll * cols, term->shown, (rows + scroll) * cols * sizeof(TermCell) );
+          memmove( term->shown_ids - scroll, term->shown_ids, (rows + scroll) * sizeof(unsigned long long) );
+     }
+
+     /* Only the rows with another content are compared */
+     for (row = 0; row < rows; row++) {
+          if (snapshot->ids[row] == term->shown_ids[row])
+               continue;
+
+          draw_row( term, snapshot->cells + row * cols, term->shown + row * cols, row, cols );
+
+          term->shown_ids[row] = snapshot->ids[row];
+     }
+}
@@ -0,0 +1,191 @@
+/*
+   This file is part of DFBTerm.
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along
+   with this program; if not, write to the Free Software Foundation, Inc.,
+   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA
+*/
+
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <term-record.h>
+#include <time.h>
+
+/**********************************************************************************************************************/
+
+struct _TermRecord {
+     FILE      *file;
+     int        replay;
+     int        fast;
+     long long  start;
+
+     char      *buffer;
+     size_t     size;
+};
+
+typedef struct {
+     uint64_t timestamp;
+     uint32_t size;
+} __attribute__((packed)) RecordHeader;
+
+static long long record_now()
+{
+     struct timespec ts;
+
+     clock_gettime( CLOCK_MONOTONIC, &ts );
+
+     return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static void record_sleep_until( long long when )
+{
+     struct timespec ts;
+
+     ts.tv_sec  = when / 1000000000LL;
+     ts.tv_nsec = when % 1000000000LL;
+
+     while (clock_nanosleep( CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL ) == EINTR);
+}
+
+/**********************************************************************************************************************/
+
+TermRecord *term_record_create( const char *filename )
+{
+     TermRecord *record;
+
+     record = calloc( 1, sizeof(TermRecord) );
+     if (!record)
+          return NULL;
+
+     record->file = fopen( filename, "wb" );
+     if (!record->file) {
+          perror( filename );
+          free( record );
+          return NULL;
+     }
+
+     fwrite( TERM_RECORD_MAGIC, 1, 8, record->file );
+
+     record->start = record_now();
+
+     return record;
+}
+
+int term_record_write( TermRecord *record, const char *buffer, size_t count )
+{
+     RecordHeader header;
+
+     if (!record || record->replay)
+          return -1;
+
+     header.timestamp = record_now() - record->start;
+     header.size      = count;
+
+     if (fwrite( &header, sizeof(header), 1, record->file ) != 1)
+          return -1;
+
+     if (count && fwrite( buffer, 1, count, record->file ) != count)
+          return -1;
+
+     return 0;
+}
+
+int term_record_flush( TermRecord *record )
+{
+     if (term_record_write( record, NULL, 0 ))
+          return -1;
+
+     /* Keep the recording usable even if the terminal does not exit cleanly */
+     return fflush( record->file );
+}
+
+TermRecord *term_record_open( const char *filename, int fast )
+{
+     char        magic[8];
+     TermRecord *record;
+
+     record = calloc( 1, sizeof(TermRecord) );
+     if (!record)
+          return NULL;
+
+     record->file = fopen( filename, "rb" );
+     if (!record->file) {
+          perror( filename );
+          free( record );
+          return NULL;
+     }
+
+     if (fread( magic, 1, 8, record->file ) != 8 || memcmp( magic, TERM_RECORD_MAGIC, 8 )) {
+          fprintf( stderr, "%s: not a DFBTerm recording\n", filename );
+          fclose( record->file );
+          free( record );
+          return NULL;
+     }
+
+     record->replay = 1;
+     record->fast   = fast;
+     record->start  = record_now();
+
+     return record;
+}
+
+int term_record_read( TermRecord *record, const char **buffer, size_t *count )
+{
+     RecordHeader header;
+
+     if (!record || !record->replay)
+          return -1;
+
+     if (fread( &header, sizeof(header), 1, record->file ) != 1)
+          return feof( record->file ) ? 0 : -1;
+
+     if (header.size > record->size) {
+          char *data = realloc( record->buffer, header.size );
+
+          if (!data)
+               return -1;
+
+          record->buffer = data;
+          record->size   = header.size;
+     }
+
+     if (header.size && fread( record->buffer, 1, header.size, record->file ) != header.size)
+          return -1;
+
+     if (!record->fast)
+          record_sleep_until( record->start + header.timestamp );
+
+     *buffer = record->buffer;
+     *count  = header.size;
+
+     return 1;
+}
+
+long long term_record_elapsed( TermRecord *record )
+{
+     return record_now() - record->start;
+}
+
+void term_record_close( TermRecord *record )
+{
+     if (!record)
+          return;
+
+     fclose( record->file );
+
+     free( record->buffer );
+     free( record );
+}
@@ -0,0 +1,56 @@
+/*
+   This file is part of DFBTerm.
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along
+   with this program; if not, write to the Free Software Foundation, Inc.,
+   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA
+*/
+
+#ifndef __TERM_RECORD_H__
+#define __TERM_RECORD_H__
+
+#include <stddef.h>
+
+/*
+ * A recording starts with the TERM_RECORD_MAGIC header, followed by records made of a 64-bit timestamp
+ * (nanoseconds since the start of the recording), a 32-bit size and the data, all in host byte order.
+ * A record with a size of zero marks the end of an update, i.e. the point where the terminal was redrawn.
+ */
+
+#define TERM_RECORD_MAGIC "DFBTREC1"
+
+typedef struct _TermRecord TermRecord;
+
+/* Recording */
+
+TermRecord *term_record_create  ( const char *filename );
+
+int         term_record_write   ( TermRecord *record, const char *buffer, size_t count );
+
+int         term_record_flush   ( TermRecord *record );
+
+/* Replay */
+
+TermRecord *term_record_open    ( const char *filename, int fast );
+
+/* Returns 1 and the next chunk (empty at the end of an update), 0 at the end of the recording, -1 on error.
+   Unless opened in fast mode, it sleeps until the chunk is due. */
+int         term_record_read    ( TermRecord *record, const char **buffer, size_t *count );
+
+/* Common */
+
+long long   term_record_elapsed ( TermRecord *record );
+
+void        term_record_close   ( TermRecord *record );
+
+#endif
@@ -0,0 +1,433 @@
+/*
+   This file is part of DFBTerm.
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along
+   with this program; if not, write to the Free Software Foundation, Inc.,
+   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include <term-snapshot.h>
+
+/* Without DirectFB, for the benchmarks */
+#ifndef MIN
+#define MIN(a,b) ((a) < (b) ? (a) : (b))
+#endif
+#ifndef MAX
+#define MAX(a,b) ((a) > (b) ? (a) : (b))
+#endif
+
+/**********************************************************************************************************************/
+
+/* Set in the latest index until the renderer takes the snapshot */
+#define SNAPSHOT_FRESH  4
+
+#ifndef USE_LIBTSM
+/* What a compose put on a row */
+typedef struct {
+     const struct vt_line *line;     /* NULL past the scrollback */
+     unsigned long long    id;       /* 0 if nothing was composed */
+     int                   sx, ex;   /* selected columns */
+     int                   cursor;   /* column of the cursor, -1 if it is not on the row */
+} ComposedRow;
+#endif
+
+struct _TermSnapshots {
+     TermSnapshot        slots[3];
+     int                 allocated[3];      /* cells */
+     int                 allocated_rows[3];
+
+     int                 fill;              /* owned by the emulator side */
+     int                 carry;             /* the snapshot to fill was published but not drawn */
+     int                 draw;              /* owned by the renderer */
+     int                 latest;            /* exchanged by both sides */
+
+#ifndef USE_LIBTSM
+     int                 cols, rows;
+     ComposedRow        *composed;          /* two sets of rows, what the latest compose and the one before put */
+     int                 composed_latest;   /* set of the latest compose */
+     unsigned long long  last_id;
+#endif
+};
+
+/**********************************************************************************************************************/
+
+TermSnapshots *term_snapshots_create()
+{
+     TermSnapshots *snapshots;
+
+     snapshots = calloc( 1, sizeof(TermSnapshots) );
+     if (!snapshots)
+          return NULL;
+
+     snapshots->fill   = 0;
+     snapshots->latest = 1;
+     snapshots->draw   = 2;
+
+     return snapshots;
+}
+
+TermSnapshot *term_snapshots_begin( TermSnapshots *snapshots, int cols, int rows )
+{
+     TermSnapshot *snapshot = &snapshots->slots[snapshots->fill];
+
+     if (cols * rows > snapshots->allocated[snapshots->fill]) {
+          TermCell *cells = realloc( snapshot->cells, cols * rows * sizeof(TermCell) );
+
+          if (!cells)
+               return NULL;
+
+          snapshot->cells = cells;
+
+          snapshots->allocated[snapshots->fill] = cols * rows;
+     }
+
+     if (rows > snapshots->allocated_rows[snapshots->fill]) {
+          unsigned long long *ids = realloc( snapshot->ids, rows * sizeof(unsigned long long) );
+
+          if (!ids)
+               return NULL;
+
+          snapshot->ids = ids;
+
+          snapshots->allocated_rows[snapshots->fill] = rows;
+     }
+
+#ifndef USE_LIBTSM
+     if (cols != snapshots->cols || rows != snapshots->rows) {
+          ComposedRow *composed = realloc( snapshots->composed, 2 * rows * sizeof(ComposedRow) );
+
+          if (!composed)
+               return NULL;
+
+          /* Nothing composed before is reused */
+          memset( composed, 0, 2 * rows * sizeof(ComposedRow) );
+
+          snapshots->composed = composed;
+          snapshots->cols     = cols;
+          snapshots->rows     = rows;
+     }
+#endif
+
+     /* The cells are not known to hold anything */
+     if (cols != snapshot->cols || rows != snapshot->rows)
+          memset( snapshot->ids, 0, rows * sizeof(unsigned long long) );
+
+     snapshot->cols = cols;
+     snapshot->rows = rows;
+
+     if (!snapshots->carry) {
+          snapshot->bytes        = 0;
+          snapshot->parse_time   = 0;
+          snapshot->publish_time = 0;
+          snapshot->read_time    = 0;
+          snapshot->has_memory   = 0;
+#ifdef USE_LIBTSM
+          snapshot->image        = NULL;
+#endif
+     }
+
+     return snapshot;
+}
+
+void term_snapshots_publish( TermSnapshots *snapshots )
+{
+     int previous;
+
+     previous = __atomic_exchange_n( &snapshots->latest, snapshots->fill | SNAPSHOT_FRESH, __ATOMIC_ACQ_REL );
+
+     snapshots->fill  = previous & ~SNAPSHOT_FRESH;
+     snapshots->carry = previous & SNAPSHOT_FRESH;
+}
+
+bool term_snapshots_pending( TermSnapshots *snapshots )
+{
+     return __atomic_load_n( &snapshots->latest, __ATOMIC_ACQUIRE ) & SNAPSHOT_FRESH;
+}
+
+TermSnapshot *term_snapshots_acquire( TermSnapshots *snapshots )
+{
+     int latest;
+
+     if (!term_snapshots_pending( snapshots ))
+          return NULL;
+
+     /* Only the renderer clears the flag, so the exchanged snapshot is a fresh one */
+     latest = __atomic_exchange_n( &snapshots->latest, snapshots->draw, __ATOMIC_ACQ_REL );
+
+     snapshots->draw = latest & ~SNAPSHOT_FRESH;
+
+     return &snapshots->slots[snapshots->draw];
+}
+
+void term_snapshots_destroy( TermSnapshots *snapshots )
+{
+     int i;
+
+     if (!snapshots)
+          return;
+
+     for (i = 0; i < 3; i++) {
+#ifdef USE_LIBTSM
+          if (snapshots->slots[i].image)
+               snapshots->slots[i].image->Release( snapshots->slots[i].image );
+#endif
+
+          free( snapshots->slots[i].cells );
+          free( snapshots->slots[i].ids );
+     }
+
+#ifndef USE_LIBTSM
+     free( snapshots->composed );
+#endif
+
+     free( snapshots );
+}
+
+/**********************************************************************************************************************/
+
+#ifdef USE_LIBTSM
+
+static int compose_cell( struct tsm_screen *screen, uint64_t id, const uint32_t *ch, size_t size, uint32_t len,
+                         uint32_t posx, uint32_t posy, const struct tsm_screen_attr *attr, tsm_age_t age,
+                         void *user_data )
+{
+     TermSnapshot *snapshot = user_data;
+     TermCell     *cell;
+
+     if (posx >= snapshot->cols || posy >= snapshot->rows)
+          return 0;
+
+     cell = &snapshot->cells[posy * snapshot->cols + posx];
+
+     cell->ch      = size ? *ch : 0;
+     cell->fr      = attr->fr;
+     cell->fg      = attr->fg;
+     cell->fb      = attr->fb;
+     cell->br      = attr->br;
+     cell->bg      = attr->bg;
+     cell->bb      = attr->bb;
+     cell->inverse = attr->inverse;
+     cell->width   = len;
+
+     return 0;
+}
+
+/* FNV-1a over the 32-bit words of the cells */
+static unsigned long long row_hash( const TermCell *cells, int cols )
+{
+     int                 i;
+     const uint32_t     *words = (const uint32_t*) cells;
+     unsigned long long  hash  = 0xcbf29ce484222325ULL;
+
+     for (i = 0; i < cols * sizeof(TermCell) / 4; i++) {
+          hash ^= words[i];
+          hash *= 0x100000001b3ULL;
+     }
+
+     return hash;
+}
+
+void term_snapshot_compose( TermSnapshots *snapshots, TermSnapshot *snapshot, struct tsm_screen *screen )
+{
+     int                row;
+     unsigned long long hash;
+
+     memset( snapshot->cells, 0, snapshot->cols * snapshot->rows * sizeof(TermCell) );
+
+     tsm_screen_draw( screen, compose_cell, snapshot );
+
+     /* libtsm does not tell which lines were modified, every row is copied and its content is its id */
+     for (row = 0; row < snapshot->rows; row++) {
+          hash = row_hash( snapshot->cells + row * snapshot->cols, snapshot->cols );
+
+          snapshot->ids[row] = hash ? hash : 1;
+     }
+
+     snapshot->sb_lines = tsm_screen_sb_get_line_count( screen );
+     snapshot->sb_pos   = tsm_screen_sb_get_line_pos( screen );
+}
+
+#else
+
+/* Columns sx to ex of screen row 'row' are selected, the same as in vt_line_update(), a system libzvt does not
+   export it */
+static void selection_span( struct _vtx *vtx, int row, int width, int *sx, int *ex )
+{
+     int start = vtx->selstarty - vtx->vt.scrollbackoffset;
+     int end   = vtx->selendy   - vtx->vt.scrollbackoffset;
+
+     *sx = *ex = -1;
+
+     if (!vtx->selected || row < MIN( start, end ) || row > MAX( start, end ))
+          return;
+
+     *sx = 0;
+     *ex = width;
+
+     if (start <= end) {
+          if (row == start)
+               *sx = vtx->selstartx;
+          if (row == end)
+               *ex = vtx->selendx;
+     }
+     else {
+          if (row == end)
+               *sx = vtx->selendx;
+          if (row == start)
+               *ex = vtx->selstartx;
+     }
+
+     if (*sx > *ex && start == end) {
+          int tmp = *sx;
+
+          *sx = *ex;
+          *ex = tmp;
+     }
+}
+
+/* A line was modified since it was composed, only the bundled libzvt tracks the modified columns */
+#ifdef ZVT_LINE_RING
+#define LINE_MODIFIED(l)  ((l)->dirtystart < (l)->dirtyend)
+#else
+#define LINE_MODIFIED(l)  ((l)->modcount)
+#endif
+
+static void compose_row( TermSnapshot *snapshot, int row, const ComposedRow *composed, struct vt_em *vt )
+{
+     int                   col, width;
+     TermCell             *cells = snapshot->cells + row * snapshot->cols;
+     const struct vt_line *line  = composed->line;
+
+     if (!line) {
+          memset( cells, 0, snapshot->cols * sizeof(TermCell) );
+          return;
+     }
+
+     width = MIN( line->width, snapshot->cols );
+
+     memcpy( cells, line->data, width * sizeof(TermCell) );
+
+     /* Lines from the scrollback may be shorter, they are continued with the attributes of their last cell */
+     for (col = width; col < snapshot->cols; col++)
+          cells[col] = width ? line->data[width-1] & VTATTR_MASK : 0;
+
+     for (col = MAX( composed->sx, 0 ); col < composed->ex && col < snapshot->cols; col++)
+          cells[col] ^= VTATTR_REVERSE;
+
+     /* The cursor swaps the colours of the cell, as in vt_draw_cursor() */
+     if (composed->cursor >= 0) {
+          TermCell attr = vt->this_line->data[composed->cursor];
+
+          cells[composed->cursor] =
+               (((attr & VTATTR_FORECOLOURM) >> VTATTR_FORECOLOURB) << VTATTR_BACKCOLOURB) |
+               (((attr & VTATTR_BACKCOLOURM) >> VTATTR_BACKCOLOURB) << VTATTR_FORECOLOURB) |
+               (attr & ~(VTATTR_FORECOLOURM | VTATTR_BACKCOLOURM));
+     }
+}
+
+void term_snapshot_compose( TermSnapshots *snapshots, TermSnapshot *snapshot, struct _vtx *vtx )
+{
+     int             row, cursory;
+     ComposedRow    *composed, *previous, *same;
+     struct vt_line *line;
+     struct vt_em   *vt = &vtx->vt;
+#ifdef ZVT_LINE_RING
+     int             index;
+#endif
+
+     previous = snapshots->composed + snapshots->composed_latest * snapshot->rows;
+
+     snapshots->composed_latest = !snapshots->composed_latest;
+
+     composed = snapshots->composed + snapshots->composed_latest * snapshot->rows;
+
+     /* Row of the cursor, if it is shown */
+     if (!vt->scrollbackoffset && vt->cursorx < vt->width && vt->cursory < snapshot->rows &&
+         vt->cursorx < snapshot->cols && !(vt->mode & VTMODE_BLANK_CURSOR))
+          cursory = vt->cursory;
+     else
+          cursory = -1;
+
+     /* First line shown, from the scrollback if it is scrolled back, as in vt_update() */
+#ifdef ZVT_LINE_RING
+     index = MAX( vt->scrollbackoffset, -vt->scrollbacklines );
+
+     line = vt_view_line( vt, index );
+#else
+     if (vt->scrollbackoffset < 0) {
+          line = (struct vt_line*) vt_list_index( &vt->scrollback, vt->scrollbackoffset );
+          if (!line)
+               line = (struct vt_line*) vt->scrollback.head;
+     }
+     else
+          line = (struct vt_line*) vt->lines.head;
+
+     /* The list ends with a node without successor */
+     if (!line->next)
+          line = NULL;
+#endif
+
+     for (row = 0; row < snapshot->rows; row++) {
+          composed[row].line   = line;
+          composed[row].cursor = row == cursory ? vt->cursorx : -1;
+
+          selection_span( vtx, row, snapshot->cols, &composed[row].sx, &composed[row].ex );
+
+          /* The line number is the row the line was composed at, as for vt_update(), or -1 for a new line */
+          if (!line)
+               same = &previous[row];
+          else if (line->line >= 0 && line->line < snapshot->rows && !LINE_MODIFIED( line ))
+               same = &previous[line->line];
+          else
+               same = NULL;
+
+          if (same && same->id && same->line == line && same->sx == composed[row].sx &&
+              same->ex == composed[row].ex && same->cursor == composed[row].cursor)
+               composed[row].id = same->id;
+          else
+               composed[row].id = ++snapshots->last_id;
+
+          /* The snapshot may still hold the row from two publishes ago */
+          if (snapshot->ids[row] != composed[row].id) {
+               compose_row( snapshot, row, &composed[row], vt );
+
+               snapshot->ids[row] = composed[row].id;
+          }
+
+          if (!line)
+               continue;
+
+          line->line     = row;
+          line->modcount = 0;
+#ifdef ZVT_LINE_RING
+          VT_LINE_CLEAN( line );
+
+          line = vt_view_next( vt, line, index++ );
+#else
+          if (line == (struct vt_line*) vt->scrollback.tailpred)
+               line = (struct vt_line*) vt->lines.head;
+          else
+               line = line->next;
+
+          if (!line->next)
+               line = NULL;
+#endif
+     }
+
+     snapshot->sb_lines = vt->scrollbacklines;
+     snapshot->sb_pos   = vt->scrollbacklines + vt->scrollbackoffset;
+}
+
+#endif
@@ -0,0 +1,106 @@
+/*
+   This file is part of DFBTerm.
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along
+   with this program; if not, write to the Free Software Foundation, Inc.,
+   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA
+*/
+
+#ifndef __TERM_SNAPSHOT_H__
+#define __TERM_SNAPSHOT_H__
+
+#include <stdbool.h>
+#ifdef USE_LIBTSM
+#include <directfb.h>
+#include <libtsm.h>
+#else
+#include <libzvt/vtx.h>
+#endif
+#include <term-stats.h>
+
+/*
+ * A snapshot is a copy of what the terminal has to show: the visible lines with the selection and the cursor
+ * applied, and the position in the scrollback.  The emulator fills one while it owns the emulator state and
+ * publishes it, the renderer draws the latest one.  Three snapshots are exchanged without locking, the one being
+ * filled, the latest published one and the one being drawn, so neither side ever waits for the other.
+ *
+ * Each row comes with an id of its content: rows with the same id are the same, wherever and in whichever snapshot
+ * they are, so only the rows with a new id are copied into a snapshot and compared with what is shown.  An id stays
+ * with a line that is scrolled without being modified.
+ */
+
+#ifdef USE_LIBTSM
+typedef struct {
+     uint32_t  ch;       /* 0 for an empty cell */
+     u8        fr, fg, fb;
+     u8        br, bg, bb;
+     u8        inverse;
+     u8        width;    /* 0 for the cells covered by a wide character */
+} TermCell;
+#else
+/* Character and attributes, as stored in a vt_line */
+typedef uint32 TermCell;
+#endif
+
+typedef struct {
+     int                 cols, rows;
+     TermCell           *cells;      /* rows of cols cells */
+     unsigned long long *ids;        /* id of the content of each row, never 0 */
+
+     int                 sb_lines;   /* lines in the scrollback */
+     int                 sb_pos;     /* first line shown, counted from the top of the scrollback */
+
+     /* Output parsed since the previous snapshot was drawn, and the time taken to publish it */
+     size_t              bytes;
+     long long           parse_time;
+     long long           publish_time;
+     long long           read_time;
+
+     int                 has_memory;
+     TermMemory          memory;
+
+#ifdef USE_LIBTSM
+     IDirectFBSurface   *image;      /* taken by the renderer */
+     int                 image_x, image_y;
+#endif
+} TermSnapshot;
+
+typedef struct _TermSnapshots TermSnapshots;
+
+TermSnapshots *term_snapshots_create ( void );
+
+/* Returns the snapshot to fill, with room for cols x rows cells.  If the previous snapshot was published but not
+   drawn, it is returned again with its statistics kept, so they add up.  Calls must be serialized by the caller. */
+TermSnapshot  *term_snapshots_begin  ( TermSnapshots *snapshots, int cols, int rows );
+
+void           term_snapshots_publish( TermSnapshots *snapshots );
+
+/* Tells whether a snapshot was published since the previous acquisition */
+bool           term_snapshots_pending( TermSnapshots *snapshots );
+
+/* Returns the latest published snapshot, or NULL if none was published since the previous call.
+   It belongs to the caller until the next call. */
+TermSnapshot  *term_snapshots_acquire( TermSnapshots *snapshots );
+
+void           term_snapshots_destroy( TermSnapshots *snapshots );
+
+/* Copy the visible lines of the emulator into the snapshot returned by term_snapshots_begin().  With libzvt the
+   lines modified since the previous call tell which rows get a new id, they are marked unmodified afterwards, with
+   libtsm the id of a row is a hash of its cells. */
+#ifdef USE_LIBTSM
+void           term_snapshot_compose ( TermSnapshots *snapshots, TermSnapshot *snapshot, struct tsm_screen *screen );
+#else
+void           term_snapshot_compose ( TermSnapshots *snapshots, TermSnapshot *snapshot, struct _vtx *vtx );
+#endif
+
+#endif
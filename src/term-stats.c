@@ -0,0 +1,325 @@
+/*
+   This file is part of DFBTerm.
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along
+   with this program; if not, write to the Free Software Foundation, Inc.,
+   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA
+*/
+
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <term-stats.h>
+#include <time.h>
+
+/**********************************************************************************************************************/
+
+static volatile sig_atomic_t dump_requested;
+
+static const char *const stage_names[TERM_STATS_NUM_STAGES] = { "parse", "publish", "draw", "flip" };
+
+static const char *const latency_names[TERM_LATENCY_NUM_STAGES] = { "input", "echo", "render", "total" };
+
+static const char *const memory_names[TERM_MEMORY_NUM_BUFFERS] = { "scrollback", "lines", "lines_back", "lines_alt",
+                                                                   "pool" };
+
+static void stats_signal_handler( int signum )
+{
+     dump_requested = 1;
+}
+
+static void histogram_add( TermHistogram *histogram, unsigned long long value )
+{
+     int bucket = 0;
+
+     while (bucket < TERM_STATS_BUCKETS - 1 && value >> bucket)
+          bucket++;
+
+     histogram->count++;
+     histogram->sum += value;
+     histogram->buckets[bucket]++;
+
+     if (histogram->max < value)
+          histogram->max = value;
+}
+
+static void histogram_dump( const TermHistogram *histogram, const char *name, const char *unit, FILE *f )
+{
+     int i;
+
+     fprintf( f, "%s (%s): count %llu, avg %.1f, max %llu\n", name, unit, histogram->count,
+              histogram->count ? (double) histogram->sum / histogram->count : 0.0, histogram->max );
+
+     for (i = 0; i < TERM_STATS_BUCKETS; i++) {
+          char range[32];
+
+          if (!histogram->buckets[i])
+               continue;
+
+          if (i == 0)
+               snprintf( range, sizeof(range), "0" );
+          else if (i == TERM_STATS_BUCKETS - 1)
+               snprintf( range, sizeof(range), "%llu -", 1ULL << (i - 1) );
+          else
+               snprintf( range, sizeof(range), "%llu - %llu", 1ULL << (i - 1), (1ULL << i) - 1 );
+
+          fprintf( f, "  %-20s %10u\n", range, histogram->buckets[i] );
+     }
+}
+
+static int compare_samples( const void *a, const void *b )
+{
+     unsigned int x = *(const unsigned int*) a;
+     unsigned int y = *(const unsigned int*) b;
+
+     return x < y ? -1 : x > y;
+}
+
+static void latency_dump( const TermLatency *latency, FILE *f )
+{
+     int          i, j, num;
+     unsigned int values[TERM_STATS_SAMPLES];
+
+     num = latency->count < TERM_STATS_SAMPLES ? latency->count : TERM_STATS_SAMPLES;
+
+     fprintf( f, "keystroke latency (us): %llu keystrokes, last %d used\n", latency->count, num );
+
+     if (!num)
+          return;
+
+     fprintf( f, "  %-8s %10s %10s %10s %10s\n", "stage", "p50", "p90", "p99", "max" );
+
+     for (i = 0; i < TERM_LATENCY_NUM_STAGES; i++) {
+          for (j = 0; j < num; j++)
+               values[j] = latency->samples[j][i];
+
+          qsort( values, num, sizeof(unsigned int), compare_samples );
+
+          fprintf( f, "  %-8s %10u %10u %10u %10u\n", latency_names[i],
+                   values[num * 50 / 100], values[num * 90 / 100], values[num * 99 / 100], values[num - 1] );
+     }
+}
+
+/**********************************************************************************************************************/
+
+TermStats *term_stats_create( const char *filename, int trace_latency )
+{
+     struct sigaction  action;
+     TermStats        *stats;
+
+     stats = calloc( 1, sizeof(TermStats) );
+     if (!stats)
+          return NULL;
+
+     if (filename)
+          stats->filename = strdup( filename );
+
+     if (trace_latency)
+          stats->latency = calloc( 1, sizeof(TermLatency) );
+
+     stats->start      = term_stats_now();
+     stats->next_write = stats->start + TERM_STATS_INTERVAL * 1000000000LL;
+
+     memset( &action, 0, sizeof(action) );
+     action.sa_handler = stats_signal_handler;
+     action.sa_flags   = SA_RESTART;
+     sigemptyset( &action.sa_mask );
+
+     sigaction( SIGUSR1, &action, NULL );
+
+     return stats;
+}
+
+void term_stats_destroy( TermStats *stats )
+{
+     if (!stats)
+          return;
+
+     signal( SIGUSR1, SIG_DFL );
+
+     free( stats->latency );
+     free( stats->filename );
+     free( stats );
+}
+
+long long term_stats_now()
+{
+     struct timespec ts;
+
+     clock_gettime( CLOCK_MONOTONIC, &ts );
+
+     return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+long long term_stats_timeval( const struct timeval *tv )
+{
+     struct timespec ts;
+     long long       time = tv->tv_sec * 1000000000LL + tv->tv_usec * 1000LL;
+     long long       now  = term_stats_now();
+
+     /* Event timestamps are either taken from the monotonic clock or from the real time clock */
+     if (time > now - 60000000000LL && time <= now)
+          return time;
+
+     clock_gettime( CLOCK_REALTIME, &ts );
+
+     return time - (ts.tv_sec * 1000000000LL + ts.tv_nsec - now);
+}
+
+void term_stats_key( TermStats *stats, long long key_time, long long write_time )
+{
+     if (!stats || !stats->latency || stats->latency->key_time)
+          return;
+
+     /* Without a usable event timestamp, start at the write */
+     if (key_time <= 0 || key_time > write_time)
+          key_time = write_time;
+
+     stats->latency->key_time   = key_time;
+     stats->latency->write_time = write_time;
+     stats->latency->read_time  = 0;
+}
+
+void term_stats_echo( TermStats *stats, long long read_time )
+{
+     if (!stats || !stats->latency || !stats->latency->key_time || stats->latency->read_time)
+          return;
+
+     if (read_time >= stats->latency->write_time)
+          stats->latency->read_time = read_time;
+}
+
+void term_stats_shown( TermStats *stats, long long flip_time )
+{
+     TermLatency  *latency;
+     unsigned int *sample;
+
+     if (!stats || !stats->latency || !stats->latency->read_time)
+          return;
+
+     latency = stats->latency;
+     sample  = latency->samples[latency->count % TERM_STATS_SAMPLES];
+
+     sample[TERM_LATENCY_INPUT]  = (latency->write_time - latency->key_time)   / 1000;
+     sample[TERM_LATENCY_ECHO]   = (latency->read_time  - latency->write_time) / 1000;
+     sample[TERM_LATENCY_RENDER] = (flip_time           - latency->read_time)  / 1000;
+     sample[TERM_LATENCY_TOTAL]  = (flip_time           - latency->key_time)   / 1000;
+
+     latency->count++;
+
+     latency->key_time = 0;
+}
+
+void term_stats_frame( TermStats *stats, size_t bytes, long long parse, long long publish, long long draw, long long flip,
+                       unsigned int area )
+{
+     if (!stats)
+          return;
+
+     stats->frames++;
+     stats->bytes += bytes;
+
+     histogram_add( &stats->stages[TERM_STATS_PARSE],   parse   / 1000 );
+     histogram_add( &stats->stages[TERM_STATS_PUBLISH], publish / 1000 );
+     histogram_add( &stats->stages[TERM_STATS_DRAW],    draw    / 1000 );
+     histogram_add( &stats->stages[TERM_STATS_FLIP],    flip    / 1000 );
+
+     histogram_add( &stats->flip_area, area );
+}
+
+void term_stats_memory( TermStats *stats, const TermMemory *memory )
+{
+     if (!stats)
+          return;
+
+     stats->memory = *memory;
+}
+
+void term_stats_dump( TermStats *stats, FILE *f )
+{
+     int       i;
+     long long elapsed = term_stats_now() - stats->start;
+
+     fprintf( f, "DFBTerm statistics after %lld.%03lld s: %llu frames, %llu bytes\n",
+              elapsed / 1000000000LL, elapsed / 1000000 % 1000, stats->frames, stats->bytes );
+
+     for (i = 0; i < TERM_STATS_NUM_STAGES; i++)
+          histogram_dump( &stats->stages[i], stage_names[i], "us", f );
+
+     histogram_dump( &stats->flip_area, "flip area", "pixels", f );
+
+     if (stats->latency)
+          latency_dump( stats->latency, f );
+
+     term_memory_dump( &stats->memory, f );
+
+     fflush( f );
+}
+
+int term_stats_due( TermStats *stats )
+{
+     if (!stats)
+          return 0;
+
+     return dump_requested || (stats->filename && term_stats_now() >= stats->next_write);
+}
+
+void term_stats_poll( TermStats *stats )
+{
+     FILE      *f;
+     long long  now;
+
+     if (!term_stats_due( stats ))
+          return;
+
+     now = term_stats_now();
+
+     dump_requested = 0;
+
+     if (stats->filename) {
+          f = fopen( stats->filename, "w" );
+          if (!f) {
+               perror( stats->filename );
+               return;
+          }
+
+          term_stats_dump( stats, f );
+
+          fclose( f );
+
+          stats->next_write = now + TERM_STATS_INTERVAL * 1000000000LL;
+     }
+     else
+          term_stats_dump( stats, stderr );
+}
+
+void term_memory_dump( const TermMemory *memory, FILE *f )
+{
+     int           i;
+     size_t        total = 0;
+     struct rusage usage;
+
+     fprintf( f, "memory (kB)%s: %u scrollback lines\n", memory->estimate ? ", estimated" : "", memory->scrollback_lines );
+
+     for (i = 0; i < TERM_MEMORY_NUM_BUFFERS; i++) {
+          fprintf( f, "  %-20s %10.1f\n", memory_names[i], memory->bytes[i] / 1024.0 );
+
+          total += memory->bytes[i];
+     }
+
+     fprintf( f, "  %-20s %10.1f\n", "total", total / 1024.0 );
+
+     if (!getrusage( RUSAGE_SELF, &usage ))
+          fprintf( f, "  %-20s %10ld\n", "peak RSS", usage.ru_maxrss );
+}
@@ -0,0 +1,132 @@
+/*
+   This file is part of DFBTerm.
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along
+   with this program; if not, write to the Free Software Foundation, Inc.,
+   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA
+*/
+
+#ifndef __TERM_STATS_H__
+#define __TERM_STATS_H__
+
+#include <stddef.h>
+#include <stdio.h>
+#include <sys/time.h>
+
+/* Histogram bucket n counts values in [2^(n-1),2^n), bucket 0 counts zero values, the last one is open-ended */
+#define TERM_STATS_BUCKETS  24
+
+/* Seconds between two writes of the statistics file */
+#define TERM_STATS_INTERVAL 10
+
+/* Number of latest keystrokes kept for the latency percentiles */
+#define TERM_STATS_SAMPLES  1024
+
+typedef enum {
+     TERM_STATS_PARSE,
+     TERM_STATS_PUBLISH,  /* composing the snapshot and packing the scrollback, under the emulator lock */
+     TERM_STATS_DRAW,
+     TERM_STATS_FLIP,
+     TERM_STATS_NUM_STAGES
+} TermStatsStage;
+
+typedef enum {
+     TERM_LATENCY_INPUT,  /* from the key event to the write to the child */
+     TERM_LATENCY_ECHO,   /* from the write to the first bytes read back */
+     TERM_LATENCY_RENDER, /* from the read to the flip showing them */
+     TERM_LATENCY_TOTAL,
+     TERM_LATENCY_NUM_STAGES
+} TermLatencyStage;
+
+typedef enum {
+     TERM_MEMORY_SCROLLBACK,
+     TERM_MEMORY_LINES,      /* visible lines */
+     TERM_MEMORY_LINES_BACK, /* last rendered lines, used to optimise the updates */
+     TERM_MEMORY_LINES_ALT,  /* alternate screen */
+     TERM_MEMORY_POOL,       /* held by the line allocator beyond the lines above */
+     TERM_MEMORY_NUM_BUFFERS
+} TermMemoryBuffer;
+
+/* Memory held by the line buffers of the emulator */
+typedef struct {
+     size_t             bytes[TERM_MEMORY_NUM_BUFFERS];
+     unsigned int       scrollback_lines;
+     int                estimate;  /* computed from the dimensions, not from the actual lines */
+} TermMemory;
+
+typedef struct {
+     unsigned long long count;
+     unsigned long long sum;
+     unsigned long long max;
+     unsigned int       buckets[TERM_STATS_BUCKETS];
+} TermHistogram;
+
+typedef struct {
+     /* keystroke being traced, zero if none */
+     long long          key_time;
+     long long          write_time;
+     long long          read_time;
+
+     unsigned long long count;
+     unsigned int       samples[TERM_STATS_SAMPLES][TERM_LATENCY_NUM_STAGES]; /* in microseconds */
+} TermLatency;
+
+typedef struct {
+     char               *filename;
+     long long           start;
+     long long           next_write;
+
+     unsigned long long  frames;
+     unsigned long long  bytes;
+
+     TermHistogram       stages[TERM_STATS_NUM_STAGES]; /* in microseconds */
+     TermHistogram       flip_area;                     /* in pixels */
+
+     TermLatency        *latency;
+
+     TermMemory          memory;
+} TermStats;
+
+/* Without filename, the statistics are only dumped to stderr on SIGUSR1 */
+TermStats *term_stats_create  ( const char *filename, int trace_latency );
+
+void       term_stats_destroy ( TermStats *stats );
+
+long long  term_stats_now     ( void );
+
+/* Convert an event timestamp to the term_stats_now() clock */
+long long  term_stats_timeval ( const struct timeval *tv );
+
+/* Account one output burst, times are in nanoseconds */
+void       term_stats_frame   ( TermStats *stats, size_t bytes, long long parse, long long publish,
+                                long long draw, long long flip, unsigned int area );
+
+/* Keystroke latency tracing, only the first keystroke is traced until it shows up on the screen */
+void       term_stats_key     ( TermStats *stats, long long key_time, long long write_time );
+void       term_stats_echo    ( TermStats *stats, long long read_time );
+void       term_stats_shown   ( TermStats *stats, long long flip_time );
+
+/* Update the memory usage reported with the statistics */
+void       term_stats_memory  ( TermStats *stats, const TermMemory *memory );
+
+void       term_stats_dump    ( TermStats *stats, FILE *f );
+
+/* Whether the next term_stats_poll() is going to dump the statistics */
+int        term_stats_due     ( TermStats *stats );
+
+/* Dump the statistics if SIGUSR1 was received or the statistics file is due */
+void       term_stats_poll    ( TermStats *stats );
+
+void       term_memory_dump   ( const TermMemory *memory, FILE *f );
+
+#endif
@@ -0,0 +1,139 @@
+/*
+   This file is part of DFBTerm.
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along
+   with this program; if not, write to the Free Software Foundation, Inc.,
+   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA
+*/
+
+#ifndef __TERM_H__
+#define __TERM_H__
+
+#include <direct/thread.h>
+#include <directfb.h>
+#ifdef USE_LIBTSM
+#include <libtsm.h>
+#else
+#include <libzvt/vtx.h>
+#endif
+#include <lite/window.h>
+#include <term-clipboard.h>
+#include <term-record.h>
+#include <term-snapshot.h>
+#include <term-stats.h>
+
+/**********************************************************************************************************************/
+
+#define TERM_FONT    "Misc-Fixed"
+#define TERM_BGALPHA  0xe0
+#define TERM_LINES    4000
+
+#define TERM_DEFAULT_FONTSIZE  13
+#define TERM_DEFAULT_COLS     100
+#define TERM_DEFAULT_ROWS      30
+
+#define TERM_HUD_COLS  16
+#define TERM_HUD_LINES  7
+
+/* Longest time in ns the screen is not published while output keeps coming */
+#define TERM_PUBLISH_INTERVAL  16000000LL
+
+typedef struct {
+     IDirectFBFont              *font;
+     int                         CW, CH;
+     int                         width, height;
+     LiteWindow                 *window;
+     IDirectFBSurface           *surface;
+     IDirectFBSurface           *bar_surface;
+     int                         bar_start, bar_end;
+     IDirectFBSurface           *hud_surface;
+     bool                        hud_visible;
+     char                        hud_text[TERM_HUD_LINES][TERM_HUD_COLS+1];
+     long long                   hud_time;
+     unsigned int                hud_frames;
+     unsigned int                hud_draws;
+     unsigned long long          hud_bytes;
+     unsigned long long          hud_area;
+     TermMemory                  hud_memory;
+
+#ifdef USE_LIBTSM
+     struct tsm_screen          *screen;
+     struct tsm_vte             *vte;
+     struct shl_pty             *pty;
+     int                         pty_bridge;
+     pid_t                       pid;
+     int                         selected;
+     int                         selectiontype;
+     IDirectFBSurface           *image;
+     int                         image_x, image_y;
+#else
+     struct _vtx                *vtx;
+#endif
+
+     /* The update thread parses the output while holding the lock, which protects the emulator state */
+     DirectThread               *update_thread;
+     bool                        update_closing;
+     DirectMutex                 lock;
+
+     /* The render thread draws the published snapshots while holding the render lock, which protects the surfaces,
+        the statistics and what is shown, it sleeps on the wait queue with the wake lock */
+     TermSnapshots              *snapshots;
+     DirectThread               *render_thread;
+     bool                        render_closing;
+     DirectMutex                 render_lock;
+     DirectMutex                 wake_lock;
+     DirectWaitQueue             render_wq;
+
+     TermCell                   *shown;
+     unsigned long long         *shown_ids;
+     int                         shown_cols, shown_rows;
+
+     TermRecord                 *record;
+     TermRecord                 *replay;
+     IDirectFBEventBuffer       *event_buffer;
+
+     TermClipboard              *clipboard;
+
+     TermStats                  *stats;
+     long long                   parse_time;
+     size_t                      parse_bytes;
+     long long                   publish_time;  /* not yet accounted in a snapshot */
+     long long                   read_time;
+     long long                   memory_time;
+
+     DFBRegion                   flip_region;
+     DFBBoolean                  flip_pending;
+
+     DFBBoolean                  in_resize;
+
+     struct timeval              last_click;
+} Term;
+
+/**********************************************************************************************************************/
+
+/* Drawing of snapshots, from term-draw.c */
+
+#ifndef USE_LIBTSM
+/* The first 16 values are the ANSI colors, the last two are the default foreground and default background */
+extern const u8 default_red[18];
+extern const u8 default_grn[18];
+extern const u8 default_blu[18];
+#endif
+
+/* Draws what changed since the previous snapshot, blitting scrolled rows */
+void term_draw_snapshot  ( Term *term, const TermSnapshot *snapshot );
+
+/* Forgets what is shown, the next snapshot is drawn completely */
+void term_draw_invalidate( Term *term );
+
+#endif
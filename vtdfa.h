@@ -0,0 +1,110 @@
+/* Generated by vtgen from vtjumps.def, do not edit */
+
+#define VT_CLASSES 28
+#define VT_CLASS_DECODED 7
+
+static const unsigned char vt_byte_class[256] = {
+   0,  0,  0,  0,  0,  0,  0,  1,  2,  2,  3,  0,  0,  2,  2,  2,
+   0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  4,  0,  0,  0,  0,
+   5,  6,  7,  8,  7,  8,  7,  9,  8,  8,  8,  8,  7,  7,  7,  7,
+  10, 10, 10, 10, 10, 10, 10, 11, 11, 10, 12, 12,  7, 13, 14, 15,
+  16, 17, 17, 17, 18, 13,  7, 16, 16,  7, 16, 16, 16, 19,  7, 20,
+  16,  7,  7, 16, 16,  7,  7,  7, 16,  7, 16, 21, 22, 23, 16,  7,
+   7,  7,  7, 19, 19,  7, 16,  7, 16,  7,  7, 16, 16, 16, 16,  7,
+  16,  7, 16,  7,  7,  7,  7,  7,  7,  7,  7,  7,  7, 16, 16,  7,
+   0,  0,  0,  0,  0,  0,  0,  2,  2,  2,  2,  0,  0,  2,  2,  2,
+   0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+   7,  7,  7,  8,  7,  8,  7,  7,  8,  8,  8,  8,  7,  7,  7,  7,
+  10, 10, 10, 10, 10, 10, 10, 11, 11, 10,  7,  7,  7, 13, 13,  7,
+  16, 17, 17, 17, 18, 13,  7, 16, 16,  7, 16, 16, 16, 19,  7,  7,
+  16,  7,  7, 16, 16,  7,  7,  7, 16,  7, 16,  7,  7,  7, 16,  7,
+   7,  7,  7, 19, 19,  7, 16,  7, 16,  7,  7, 16, 16, 16, 16,  7,
+  16,  7, 16,  7,  7,  7,  7,  7,  7,  7,  7,  7,  7, 16, 16,  7,
+};
+
+/* classes of the ascii characters decoded from overlong utf-8 sequences */
+static const unsigned char vt_decoded_class[128] = {
+   7,  7,  7,  7,  7,  7,  7, 24,  7,  7, 25,  7,  7,  7,  7,  7,
+   7,  7,  7,  7,  7,  7,  7,  7,  7,  7,  7, 26,  7,  7,  7,  7,
+   5,  6,  7,  7,  7,  7,  7,  9,  7,  7,  7,  7,  7,  7,  7,  7,
+   7,  7,  7,  7,  7,  7,  7,  7,  7,  7, 12, 12,  7,  7, 27, 15,
+   7,  7,  7,  7,  7,  7,  7,  7,  7,  7,  7,  7,  7,  7,  7, 20,
+   7,  7,  7,  7,  7,  7,  7,  7,  7,  7,  7, 21, 22, 23,  7,  7,
+   7,  7,  7,  7,  7,  7,  7,  7,  7,  7,  7,  7,  7,  7,  7,  7,
+   7,  7,  7,  7,  7,  7,  7,  7,  7,  7,  7,  7,  7,  7,  7,  7,
+};
+
+static const struct vt_transition vt_transitions[VT_STATES][VT_CLASSES] = {
+  {
+    {0,0}, {2,0}, {2,0}, {2,0}, {0,1}, {1,0}, {1,0}, {1,0},
+    {1,0}, {1,0}, {1,0}, {1,0}, {1,0}, {1,0}, {1,0}, {1,0},
+    {1,0}, {1,0}, {1,0}, {1,0}, {1,0}, {1,0}, {1,0}, {1,0},
+    {1,0}, {1,0}, {1,0}, {1,0},
+  },
+  {
+    {0,0}, {0,0}, {0,0}, {0,0}, {0,0}, {0,0}, {0,0}, {0,0},
+    {13,5}, {0,0}, {0,0}, {3,0}, {0,0}, {3,0}, {3,0}, {0,0},
+    {0,0}, {0,0}, {3,0}, {3,0}, {0,3}, {4,2}, {0,0}, {6,4},
+    {0,0}, {0,0}, {0,0}, {0,0},
+  },
+  {
+    {0,0}, {2,2}, {2,2}, {2,2}, {0,0}, {0,7}, {0,8}, {0,0},
+    {0,0}, {0,9}, {10,2}, {10,2}, {11,2}, {0,0}, {0,10}, {0,6},
+    {12,0}, {12,0}, {12,0}, {12,0}, {0,0}, {0,0}, {0,0}, {0,0},
+    {0,0}, {0,0}, {0,0}, {0,10},
+  },
+  {
+    {0,0}, {0,0}, {0,0}, {0,0}, {0,0}, {0,0}, {0,0}, {0,0},
+    {0,0}, {0,0}, {0,0}, {0,0}, {0,0}, {0,0}, {0,0}, {0,0},
+    {0,0}, {5,0}, {5,0}, {0,0}, {0,0}, {0,0}, {0,0}, {0,0},
+    {0,0}, {0,0}, {0,0}, {0,0},
+  },
+  {
+    {7,4}, {8,0}, {7,4}, {9,0}, {0,11}, {7,4}, {7,4}, {7,4},
+    {7,4}, {7,4}, {7,4}, {7,4}, {7,4}, {7,4}, {7,4}, {7,4},
+    {7,4}, {7,4}, {7,4}, {7,4}, {7,4}, {7,4}, {7,4}, {7,4},
+    {8,0}, {9,0}, {0,11}, {7,4},
+  },
+  {
+    {14,0}, {14,0}, {14,0}, {14,0}, {14,0}, {14,0}, {14,0}, {14,0},
+    {14,0}, {14,0}, {14,0}, {14,0}, {14,0}, {14,0}, {14,0}, {14,0},
+    {14,0}, {14,0}, {14,0}, {14,0}, {14,0}, {14,0}, {14,0}, {14,0},
+    {14,0}, {14,0}, {14,0}, {14,0},
+  },
+  {
+    {0,0}, {2,6}, {2,6}, {2,6}, {0,0}, {0,7}, {0,0}, {0,0},
+    {0,0}, {0,9}, {10,6}, {10,6}, {11,6}, {0,0}, {0,0}, {0,0},
+    {12,0}, {12,0}, {12,0}, {12,0}, {0,0}, {0,0}, {0,0}, {0,0},
+    {0,0}, {0,0}, {0,0}, {0,0},
+  },
+  {
+    {0,0}, {2,7}, {2,7}, {2,7}, {0,0}, {0,7}, {0,0}, {0,0},
+    {0,0}, {0,9}, {10,7}, {10,7}, {11,7}, {0,0}, {0,0}, {0,0},
+    {12,0}, {12,0}, {12,0}, {12,0}, {0,0}, {0,0}, {0,0}, {0,0},
+    {0,0}, {0,0}, {0,0}, {0,0},
+  },
+  {
+    {0,0}, {2,8}, {2,8}, {2,8}, {0,0}, {0,7}, {0,0}, {0,0},
+    {0,0}, {0,9}, {10,8}, {10,8}, {11,8}, {0,0}, {0,0}, {0,0},
+    {12,0}, {12,0}, {12,0}, {12,0}, {0,0}, {0,0}, {0,0}, {0,0},
+    {0,0}, {0,0}, {0,0}, {0,0},
+  },
+  {
+    {0,0}, {2,9}, {2,9}, {2,9}, {0,0}, {0,7}, {0,0}, {0,0},
+    {0,0}, {0,9}, {10,9}, {10,9}, {11,9}, {0,0}, {0,0}, {0,0},
+    {12,0}, {12,0}, {12,0}, {12,0}, {0,0}, {0,0}, {0,0}, {0,0},
+    {0,0}, {0,0}, {0,0}, {0,0},
+  },
+  {
+    {0,0}, {2,10}, {2,10}, {2,10}, {0,0}, {0,7}, {0,0}, {0,0},
+    {0,0}, {0,9}, {10,10}, {10,10}, {11,10}, {0,0}, {0,0}, {0,0},
+    {12,0}, {12,0}, {12,0}, {12,0}, {0,0}, {0,0}, {0,0}, {0,0},
+    {0,0}, {0,0}, {0,0}, {0,0},
+  },
+  {
+    {0,0}, {0,0}, {0,0}, {0,0}, {0,0}, {0,0}, {0,0}, {0,0},
+    {13,5}, {0,0}, {0,0}, {3,0}, {0,0}, {3,0}, {3,0}, {0,0},
+    {0,0}, {0,0}, {3,0}, {3,0}, {0,3}, {4,2}, {8,0}, {6,4},
+    {0,0}, {0,0}, {0,0}, {0,0},
+  },
+};